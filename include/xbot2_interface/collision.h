@@ -189,6 +189,49 @@ public:
      */
     void resetLinksVsEnvironment();
 
+    /**
+     * @brief set the number of threads that computeDistance() uses for the exact
+     * (narrowphase) distance computation; the default is one (i.e. the calling
+     * thread only). Worker threads are persistent, and the calling thread takes
+     * part in the computation. The output does not depend on the number of threads.
+     * @param num_threads: total number of threads, including the calling one
+     * @param cpus: if not empty, cpus[i] is the cpu the i-th worker thread is
+     * pinned to (size must be num_threads - 1); throws if a cpu index is invalid
+     * or a worker thread cannot be pinned
+     */
+    void setNumThreads(int num_threads, std::vector<int> cpus = {});
+
+    /**
+     * @brief returns the number of threads used by computeDistance()
+     */
+    int getNumThreads() const;
+
+    /**
+     * @brief enable or disable warm starting the GJK algorithm of each collision
+     * pair with the separating direction and support vertices found by its previous
+     * query (enabled by default); this is effective as long as consecutive queries
+     * are performed on nearby configurations (e.g. at every control cycle)
+     */
+    void setGjkWarmStart(bool flag);
+
+    /**
+     * @brief returns true if GJK warm start is enabled
+     */
+    bool getGjkWarmStart() const;
+
+    /**
+     * @brief getComputationStatistics returns counters about the queries performed
+     * so far, i.e. the number of computeDistance() and checkCollision() calls, and the
+     * number of collision pairs that were actually evaluated by them (i.e. not culled
+     * by the broadphase), the number of link Jacobians computed by the distance
+     * Jacobian getters, and the number of GJK runs performed by computeDistance()
+     * ("gjk_evaluations") together with their total number of iterations
+     * ("gjk_iterations", only reported with hpp-fcl >= 3)
+     */
+    std::map<std::string, uint64_t> getComputationStatistics() const;
+
+    void resetComputationStatistics();
+
     /**
      * @brief checkSelfCollision
      * @return
@@ -222,9 +265,10 @@ public:
 
     /**
      * @brief performs distance computation for all active collision pairs; if the threshold
-     * parameter is greater than zero, this function will only compute cheaper approximate
-     * distance between collision pairs whose distance can be proved to be above the given
-     * thresold, by means of an inexpensive AABB overlap test.
+     * parameter is greater than zero, the exact distance is only computed for collision pairs
+     * whose AABBs are closer than the given threshold. All other pairs (i.e. whose distance
+     * is proved to be above the threshold) are reported with infinite distance; most of them
+     * are culled by the broadphase, and are not evaluated at all.
      * @param threshold: min distance below which exact distance computation is performed
      * @return vector of distances, one for each collision pair
      */
@@ -233,10 +277,11 @@ public:
 
     /**
      * @brief performs distance computation for all active collision pairs; if the threshold
-     * parameter is greater than zero, this function will only compute cheaper approximate
-     * distance between collision pairs whose distance can be proved to be above the given
-     * thresold, by means of an inexpensive AABB overlap test. Witness points and normals
-     * for the simplified AABB overlap test are available after this call.
+     * parameter is greater than zero, the exact distance is only computed for collision pairs
+     * whose AABBs are closer than the given threshold. All other pairs (i.e. whose distance
+     * is proved to be above the threshold) are reported with infinite distance, zero normal
+     * and zero witness points; most of them are culled by the broadphase, and are not
+     * evaluated at all.
      * @param threshold: min distance below which exact distance computation is performed
      * @param d (output) vector of distances, one for each collision pair
      */
@@ -266,7 +311,11 @@ public:
     /**
      * @brief return the approximate distance Jacobian; this assumes witness points do not
      * change with configuration
-     * @note it requires calling update() and computeDistance() first
+     * @note it requires calling update() and computeDistance() first; the model
+     * must not be updated in between, as link Jacobians are computed on demand
+     * @note rows of pairs whose distance is above the threshold given to the last
+     * computeDistance() call are zero; link Jacobians are only computed for the
+     * remaining ones
      */
     Eigen::MatrixXd getDistanceJacobian(bool include_env = false) const;
 
@@ -278,6 +327,37 @@ public:
      */
     void getDistanceJacobian(MatRef J, bool include_env = false) const;
 
+    /**
+     * @brief return the distance Jacobian of the active collision pairs only, i.e. those
+     * whose distance (as computed by the last computeDistance() call) is below the given
+     * threshold; rows are computed from the cached witness points and normals
+     * @note it requires calling update() and computeDistance() first, and the model
+     * must not be updated in between
+     * @note no memory is allocated as long as the outputs have enough capacity, and J
+     * already has the right size (e.g. the active set did not change since the last call)
+     * @param threshold: pairs with distance below this value are active
+     * @param active_idx (output) indices of the active pairs, in ascending order
+     * @param J (output) active_idx.size() x model->getNv() Jacobian, whose k-th row
+     * corresponds to the active_idx[k]-th collision pair
+     */
+    void getActiveDistanceJacobian(double threshold,
+                                   std::vector<int>& active_idx,
+                                   Eigen::MatrixXd& J,
+                                   bool include_env = false) const;
+
+    /**
+     * @brief same as above, but J only contains those columns that can be non-zero
+     * for some active pair (i.e. the union of the Jacobian supports of the involved links)
+     * @param active_cols (output) indices of the columns of J inside the full Jacobian,
+     * in ascending order
+     * @param J (output) active_idx.size() x active_cols.size() Jacobian
+     */
+    void getActiveDistanceJacobian(double threshold,
+                                   std::vector<int>& active_idx,
+                                   std::vector<int>& active_cols,
+                                   Eigen::MatrixXd& J,
+                                   bool include_env = false) const;
+
     /**
      * @brief returned the vector of collision pair indices, in ascending distance order
      */
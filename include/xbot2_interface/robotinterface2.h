@@ -113,6 +113,9 @@ public:
     using XBotInterface::getJdotTimesV;
     Eigen::Vector6d getJdotTimesV(int link_id) const override;
 
+    using XBotInterface::getJacobianTimeVariation;
+    void getJacobianTimeVariation(int link_id, MatRef dJ) const override;
+
     using XBotInterface::getCOM;
     Eigen::Vector3d getCOM() const override;
 
@@ -155,6 +158,9 @@ public:
     using XBotInterface::computeCentroidalMomentum;
     Eigen::Vector6d computeCentroidalMomentum() const override;
 
+    using XBotInterface::computeCentroidalMomentumMatrixTimeVariation;
+    MatConstRef computeCentroidalMomentumMatrixTimeVariation() const override;
+
 protected:
 
     JointParametrization get_joint_parametrization(string_const_ref jname) override;
@@ -127,6 +127,13 @@ public:
 
     void update();
 
+    /**
+     * @brief getUpdateCount returns the number of update() calls so far; it
+     * allows to detect whether quantities computed at some point (e.g. by
+     * a CollisionModel) still refer to the current kinematic state
+     */
+    uint64_t getUpdateCount() const;
+
     virtual int getLinkId(string_const_ref link_name) const = 0;
 
     string_const_ref getLinkName(int id) const;
@@ -246,6 +253,45 @@ public:
     Eigen::MatrixXd getRelativeJacobian(string_const_ref distal_name,
                                         string_const_ref base_name) const;
 
+    // compact (structurally non-zero columns only)
+
+    /**
+     * @brief getJacobianSupport returns the sorted indices of the jacobian
+     * columns that can be non-zero for the given link, i.e. the velocity
+     * indices of all joints along the path from the root to the link
+     * @note links that are not part of the urdf (e.g. added via
+     * ModelInterface::addFixedLink) are given the full column range
+     */
+    const std::vector<int>& getJacobianSupport(int link_id) const;
+
+    const std::vector<int>& getJacobianSupport(string_const_ref link_name) const;
+
+    /**
+     * @brief getJacobianCompact returns the jacobian columns listed by
+     * getJacobianSupport(link_id), i.e. a 6 x getJacobianSupport(link_id).size()
+     * matrix
+     * @note this is a convenience gather of the columns of getJacobian(link_id),
+     * which is still computed in full: it saves memory and downstream products
+     * (e.g. inside a QP), not the jacobian computation itself
+     */
+    virtual void getJacobianCompact(int link_id,
+                                    MatRef Jc) const;
+
+    // time variation
+
+    /**
+     * @brief getJacobianTimeVariation returns the time derivative of the
+     * jacobian returned by getJacobian(link_id), so that
+     * dJ * v == getJdotTimesV(link_id)
+     */
+    virtual void getJacobianTimeVariation(int link_id,
+                                          MatRef dJ) const;
+
+    bool getJacobianTimeVariation(string_const_ref link_name,
+                                  MatRef dJ) const;
+
+    Eigen::MatrixXd getJacobianTimeVariation(string_const_ref link_name) const;
+
     /* Forward kinematics */
 
     // pose (absolute)
@@ -382,12 +428,77 @@ public:
 
     virtual Eigen::Vector6d computeCentroidalMomentum() const;
 
+    /**
+     * @brief computeCentroidalMomentumMatrixTimeVariation returns the time
+     * derivative of the centroidal momentum matrix
+     */
+    virtual MatConstRef computeCentroidalMomentumMatrixTimeVariation() const;
+
+    void computeCentroidalMomentumMatrixTimeVariation(Eigen::MatrixXd& dAg) const;
+
+    /**
+     * @brief computeCentroidalMomentumMatrixDotTimesV returns dAg/dt * v,
+     * i.e. the part of the centroidal momentum rate which does not
+     * depend on the joint acceleration
+     */
+    Eigen::Vector6d computeCentroidalMomentumMatrixDotTimesV() const;
+
     void computeForwardDynamics(Eigen::VectorXd& fd) const;
 
     void computeInertiaMatrix(Eigen::MatrixXd& M) const;
 
     void computeInertiaInverse(Eigen::MatrixXd& Minv) const;
 
+    // inertia matrix factorization
+
+    /**
+     * @brief computeInertiaInverseTimes computes M^-1 * B from a
+     * factorization of the inertia matrix, without forming M^-1
+     * @param B nv x k (k = 1 for a vector)
+     * @param MinvB (output) nv x k
+     */
+    virtual void computeInertiaInverseTimes(MatConstRef B,
+                                            MatRef MinvB) const;
+
+    /**
+     * @brief computeInverseOperationalSpaceInertia computes J * M^-1 * J^T
+     * from a factorization of the inertia matrix, without forming M^-1
+     * @param J m x nv (e.g. one or more stacked jacobians)
+     * @param Linv (output) m x m
+     */
+    virtual void computeInverseOperationalSpaceInertia(MatConstRef J,
+                                                       MatRef Linv) const;
+
+    // operational space
+
+    /**
+     * @brief computeOperationalSpaceInertia computes the operational space
+     * inertia Lambda = (J * M^-1 * J^T)^-1, where J stacks the jacobians of
+     * the given links (in the getJacobian() convention)
+     * @param Lambda (output) 6k x 6k, with k = link_ids.size()
+     * @note the result is cached until the next update(), for up to
+     * four distinct link sets (the least recently used one is replaced)
+     * @throw std::runtime_error if J * M^-1 * J^T is singular, i.e. the
+     * stacked jacobian is rank deficient (e.g. a link appears twice, or
+     * at a kinematic singularity)
+     */
+    void computeOperationalSpaceInertia(const std::vector<int>& link_ids,
+                                        MatRef Lambda) const;
+
+    void computeOperationalSpaceInertia(int link_id,
+                                        MatRef Lambda) const;
+
+    /**
+     * @brief computeDynamicallyConsistentInverse computes the dynamically
+     * consistent generalized inverse Jbar = M^-1 * J^T * Lambda of the
+     * stacked jacobian of the given links
+     * @param Jbar (output) nv x 6k, with k = link_ids.size()
+     * @throw std::runtime_error under the same conditions as
+     * computeOperationalSpaceInertia()
+     */
+    void computeDynamicallyConsistentInverse(const std::vector<int>& link_ids,
+                                             MatRef Jbar) const;
+
     // manifold operations
     virtual void sum(VecConstRef q0,
                      VecConstRef v,
@@ -559,12 +670,408 @@ public:
 
     bool setFloatingBaseTwist(const Eigen::Vector6d& v);
 
+    /* Dynamics derivatives */
+
+    /**
+     * @brief computeInverseDynamicsDerivatives computes the partial derivatives
+     * of computeInverseDynamics() w.r.t. the joint position (in the tangent
+     * space, i.e. along sum(q, dq)), velocity and acceleration
+     * @param dtau_dq (output) nv x nv
+     * @param dtau_dv (output) nv x nv
+     * @param dtau_da (output) nv x nv, this is the joint space inertia matrix
+     */
+    virtual void computeInverseDynamicsDerivatives(MatRef dtau_dq,
+                                                   MatRef dtau_dv,
+                                                   MatRef dtau_da) const;
+
+    /**
+     * @brief computeForwardDynamicsDerivatives computes the partial derivatives
+     * of computeForwardDynamics() w.r.t. the joint position (in the tangent
+     * space), velocity and effort
+     * @param dddq_dq (output) nv x nv
+     * @param dddq_dv (output) nv x nv
+     * @param dddq_dtau (output) nv x nv, this is the inverse of the joint space
+     * inertia matrix
+     */
+    virtual void computeForwardDynamicsDerivatives(MatRef dddq_dq,
+                                                   MatRef dddq_dv,
+                                                   MatRef dddq_dtau) const;
+
+    /**
+     * @brief computeCentroidalDynamicsDerivatives computes the partial derivatives
+     * of the centroidal momentum h = Ag * v and of its rate of change
+     * dh/dt = Ag * a + dAg/dt * v w.r.t. the joint position (in the tangent
+     * space), velocity and acceleration; note that dh/dv = dh/dt/da = Ag
+     * @param dh_dq (output) 6 x nv
+     * @param dhdot_dq (output) 6 x nv
+     * @param dhdot_dv (output) 6 x nv
+     * @param dhdot_da (output) 6 x nv
+     */
+    virtual void computeCentroidalDynamicsDerivatives(MatRef dh_dq,
+                                                      MatRef dhdot_dq,
+                                                      MatRef dhdot_dv,
+                                                      MatRef dhdot_da) const;
+
+    /* Constrained dynamics */
+
+    enum class ContactType
+    {
+        Point3D,  // linear acceleration of the link origin is zero
+        Frame6D   // spatial acceleration of the link is zero
+    };
+
+    /**
+     * @brief setContacts registers the set of links in rigid contact with
+     * the environment, to be used by computeConstrainedDynamics()
+     */
+    virtual void setContacts(const std::vector<int>& link_ids,
+                             const std::vector<ContactType>& types);
+
+    bool setContacts(const std::vector<std::string>& link_names,
+                     const std::vector<ContactType>& types);
+
+    /**
+     * @brief getContactDimension returns the number of contact force
+     * components for the registered contacts (3 per point, 6 per frame)
+     */
+    virtual int getContactDimension() const;
+
+    /**
+     * @brief computeConstrainedDynamics computes the joint accelerations
+     * and the contact forces resulting from the current joint effort,
+     * subject to the registered contacts
+     * @param ddq (output) nv
+     * @param lambda (output) getContactDimension(), stacked contact forces
+     * (wrenches for 6D contacts) in the getJacobian() convention
+     */
+    virtual void computeConstrainedDynamics(VecRef ddq,
+                                            VecRef lambda) const;
+
+    /**
+     * @brief computeImpulseDynamics computes the joint velocity after an
+     * impact with the registered contacts, taking the current joint velocity
+     * as the pre-impact one
+     * @param v_after (output) nv
+     * @param impulse (output) getContactDimension(), stacked contact impulses
+     * in the getJacobian() convention
+     * @param restitution coefficient of restitution (0 = plastic impact)
+     */
+    virtual void computeImpulseDynamics(VecRef v_after,
+                                        VecRef impulse,
+                                        double restitution = 0.0) const;
+
+    /* Dynamic parameters */
+
+    /**
+     * @brief getDynamicParameters returns the stacked inertial parameters of
+     * all bodies, 10 per body, i.e. (m, m*c, I_xx, I_xy, I_yy, I_xz, I_yz, I_zz)
+     * expressed in the body's parent joint frame
+     */
+    virtual Eigen::VectorXd getDynamicParameters() const;
+
+    /**
+     * @brief computeRegressor computes the joint torque regressor Y(q, v, a),
+     * such that computeInverseDynamics() == Y * getDynamicParameters()
+     * @return nv x getDynamicParameters().size() matrix
+     */
+    virtual MatConstRef computeRegressor() const;
+
+    /* Kinematics derivatives */
+
+    /**
+     * @brief getVelocityTwistDerivatives computes the partial derivatives
+     * of getVelocityTwist(link_id) w.r.t. the joint position (in the tangent
+     * space) and velocity
+     * @param dv_dq (output) 6 x nv
+     * @param dv_dv (output) 6 x nv, this is the link jacobian
+     */
+    virtual void getVelocityTwistDerivatives(int link_id,
+                                             MatRef dv_dq,
+                                             MatRef dv_dv) const;
+
+    /**
+     * @brief getAccelerationTwistDerivatives computes the partial derivatives
+     * of getAccelerationTwist(link_id) w.r.t. the joint position (in the
+     * tangent space), velocity and acceleration
+     * @param da_dq (output) 6 x nv
+     * @param da_dv (output) 6 x nv
+     * @param da_da (output) 6 x nv, this is the link jacobian
+     */
+    virtual void getAccelerationTwistDerivatives(int link_id,
+                                                 MatRef da_dq,
+                                                 MatRef da_dv,
+                                                 MatRef da_da) const;
+
+    /* Hot links */
+
+    /**
+     * @brief setHotLinks registers the set of links whose pose is queried
+     * at every control cycle (e.g. task links, collision links, sensors);
+     * backends can use this information to update their placement together
+     * with forward kinematics, while computing the remaining links only on
+     * demand
+     * @note this is a performance hint, queries on any link remain valid
+     */
+    virtual void setHotLinks(const std::vector<int>& link_ids);
+
+    bool setHotLinks(const std::vector<std::string>& link_names);
+
+    /* Computation statistics */
+
+    /**
+     * @brief getComputationStatistics returns backend-specific counters
+     * about the computations performed for queries on the model state
+     * (e.g. which algorithm was selected, how many results were served
+     * from cache)
+     */
+    virtual std::map<std::string, uint64_t> getComputationStatistics() const;
+
+    /**
+     * @brief resetComputationStatistics sets all counters to zero
+     */
+    virtual void resetComputationStatistics();
+
+    /* Computation workspaces */
+
+    /**
+     * @brief A Workspace owns the state (q, v, a, tau) and all the
+     * algorithm buffers and caches that are required to evaluate
+     * kinematics and dynamics quantities for a given model.
+     * Queries taking a workspace as first argument only write into the
+     * workspace, so that multiple threads can query a shared (and not
+     * concurrently modified) model, each one with its own workspace.
+     */
+    class XBOT2IFC_API Workspace
+    {
+
+    public:
+
+        XBOT_DECLARE_SMART_PTR(Workspace);
+
+        VecConstRef getJointPosition() const;
+
+        VecConstRef getJointVelocity() const;
+
+        VecConstRef getJointAcceleration() const;
+
+        VecConstRef getJointEffort() const;
+
+        virtual ~Workspace();
+
+    protected:
+
+        Eigen::VectorXd _q, _v, _a, _tau;
+
+        friend ModelInterface;
+    };
+
+    /**
+     * @brief createWorkspace returns a new workspace for this model,
+     * initialized with the current model state
+     */
+    Workspace::UniquePtr createWorkspace() const;
+
+    /**
+     * @brief updateWorkspace sets the workspace state to the current model
+     * state, and invalidates all computations cached inside ws
+     */
+    void updateWorkspace(Workspace& ws) const;
+
+    /**
+     * @brief updateWorkspace sets the workspace state to the provided one
+     * (velocity, acceleration and effort are set to zero if not provided),
+     * and invalidates all computations cached inside ws
+     */
+    void updateWorkspace(Workspace& ws,
+                         VecConstRef q) const;
+
+    void updateWorkspace(Workspace& ws,
+                         VecConstRef q,
+                         VecConstRef v,
+                         VecConstRef a,
+                         VecConstRef tau) const;
+
+    using XBotInterface::getPose;
+    virtual Eigen::Affine3d getPose(Workspace& ws, int link_id) const;
+
+    using XBotInterface::getJacobian;
+    virtual void getJacobian(Workspace& ws, int link_id, MatRef J) const;
+
+    using XBotInterface::getVelocityTwist;
+    virtual Eigen::Vector6d getVelocityTwist(Workspace& ws, int link_id) const;
+
+    using XBotInterface::getAccelerationTwist;
+    virtual Eigen::Vector6d getAccelerationTwist(Workspace& ws, int link_id) const;
+
+    using XBotInterface::getJdotTimesV;
+    virtual Eigen::Vector6d getJdotTimesV(Workspace& ws, int link_id) const;
+
+    using XBotInterface::getJacobianTimeVariation;
+    virtual void getJacobianTimeVariation(Workspace& ws, int link_id, MatRef dJ) const;
+
+    using XBotInterface::getCOM;
+    virtual Eigen::Vector3d getCOM(Workspace& ws) const;
+
+    using XBotInterface::getCOMJacobian;
+    virtual void getCOMJacobian(Workspace& ws, MatRef J) const;
+
+    using XBotInterface::computeInverseDynamics;
+    virtual VecConstRef computeInverseDynamics(Workspace& ws) const;
+
+    using XBotInterface::computeGravityCompensation;
+    virtual VecConstRef computeGravityCompensation(Workspace& ws) const;
+
+    using XBotInterface::computeNonlinearTerm;
+    virtual VecConstRef computeNonlinearTerm(Workspace& ws) const;
+
+    using XBotInterface::computeForwardDynamics;
+    virtual VecConstRef computeForwardDynamics(Workspace& ws) const;
+
+    virtual void computeInverseDynamicsDerivatives(Workspace& ws,
+                                                   MatRef dtau_dq,
+                                                   MatRef dtau_dv,
+                                                   MatRef dtau_da) const;
+
+    virtual void computeForwardDynamicsDerivatives(Workspace& ws,
+                                                   MatRef dddq_dq,
+                                                   MatRef dddq_dv,
+                                                   MatRef dddq_dtau) const;
+
+    virtual void computeCentroidalDynamicsDerivatives(Workspace& ws,
+                                                      MatRef dh_dq,
+                                                      MatRef dhdot_dq,
+                                                      MatRef dhdot_dv,
+                                                      MatRef dhdot_da) const;
+
+    virtual void computeConstrainedDynamics(Workspace& ws,
+                                            VecRef ddq,
+                                            VecRef lambda) const;
+
+    virtual MatConstRef computeRegressor(Workspace& ws) const;
+
+    virtual void computeImpulseDynamics(Workspace& ws,
+                                        VecRef v_after,
+                                        VecRef impulse,
+                                        double restitution = 0.0) const;
+
+    virtual void getVelocityTwistDerivatives(Workspace& ws,
+                                             int link_id,
+                                             MatRef dv_dq,
+                                             MatRef dv_dv) const;
+
+    virtual void getAccelerationTwistDerivatives(Workspace& ws,
+                                                 int link_id,
+                                                 MatRef da_dq,
+                                                 MatRef da_dv,
+                                                 MatRef da_da) const;
+
+    using XBotInterface::computeInertiaMatrix;
+    virtual MatConstRef computeInertiaMatrix(Workspace& ws) const;
+
+    using XBotInterface::computeInertiaInverse;
+    virtual MatConstRef computeInertiaInverse(Workspace& ws) const;
+
+    using XBotInterface::computeInertiaInverseTimes;
+    virtual void computeInertiaInverseTimes(Workspace& ws, MatConstRef B, MatRef MinvB) const;
+
+    using XBotInterface::computeInverseOperationalSpaceInertia;
+    virtual void computeInverseOperationalSpaceInertia(Workspace& ws, MatConstRef J, MatRef Linv) const;
+
+    using XBotInterface::computeCentroidalMomentumMatrix;
+    virtual MatConstRef computeCentroidalMomentumMatrix(Workspace& ws) const;
+
+    using XBotInterface::computeCentroidalMomentumMatrixTimeVariation;
+    virtual MatConstRef computeCentroidalMomentumMatrixTimeVariation(Workspace& ws) const;
+
+    /* Batched evaluation */
+
+    /**
+     * @brief Preallocated inputs/outputs for evaluateBatch().
+     * Results for sample i are stored as follows:
+     *  - poses[i*nlinks + k] is the pose of link_ids[k]
+     *  - jacobians.block(6*k, nv*i, 6, nv) is the jacobian of link_ids[k]
+     *  - gcomp.col(i) is the gravity compensation torque
+     *  - inertia.middleCols(nv*i, nv) is the joint space inertia matrix
+     *  - regressor.middleRows(nv*i, nv) is the joint torque regressor
+     *    (requires velocities and accelerations)
+     */
+    struct XBOT2IFC_API BatchData
+    {
+        enum Computation
+        {
+            None = 0,
+            Poses = 1,
+            Jacobians = 2,
+            GravityCompensation = 4,
+            InertiaMatrix = 8,
+            Regressor = 16
+        };
+
+        std::vector<int> link_ids;
+
+        int computation = None;
+
+        std::vector<Eigen::Affine3d> poses;
+
+        Eigen::MatrixXd jacobians;
+
+        Eigen::MatrixXd gcomp;
+
+        Eigen::MatrixXd inertia;
+
+        Eigen::MatrixXd regressor;
+
+        int getNumSamples() const;
+
+        void resize(const ModelInterface& model, int n_samples);
+
+    private:
+
+        int _n_samples = 0;
+    };
+
+    /**
+     * @brief evaluateBatch computes the quantities requested by data.computation
+     * for each column of Q (nq x N), without modifying the model state nor its
+     * cached computations; samples are split among n_threads workers, each owning
+     * its private algorithm workspace
+     * @note worker threads are persistent (they are re-created only when n_threads
+     * changes); concurrent calls on the same model are serialized
+     */
+    void evaluateBatch(MatConstRef Q,
+                       BatchData& data,
+                       int n_threads = 1) const;
+
+    /**
+     * @brief evaluateBatch overload for computations that depend on the
+     * joint velocity and acceleration, given as columns of V and A (nv x N)
+     */
+    void evaluateBatch(MatConstRef Q,
+                       MatConstRef V,
+                       MatConstRef A,
+                       BatchData& data,
+                       int n_threads = 1) const;
+
     virtual ~ModelInterface();
 
 protected:
 
     using XBotInterface::XBotInterface;
 
+    virtual Workspace::UniquePtr create_workspace_impl() const;
+
+    virtual void update_workspace_impl(Workspace& ws) const;
+
+    virtual void init_batch_workers(int n_workers) const;
+
+    virtual void evaluate_batch_impl(MatConstRef Q,
+                                     MatConstRef V,
+                                     MatConstRef A,
+                                     int sample_begin,
+                                     int sample_end,
+                                     int worker,
+                                     BatchData& data) const;
+
 };
 
 using ConfigOptions = XBotInterface::ConfigOptions;
@@ -1,36 +1,66 @@
 #include "modelinterface2_pin.h"
 
+#include <algorithm>
+#include <bit>
+
 #include <xbot2_interface/common/plugin.h>
 #include <xbot2_interface/common/utils.h>
 
 #include <pinocchio/algorithm/center-of-mass.hpp>
 #include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/frames-derivatives.hpp>
 #include <pinocchio/algorithm/jacobian.hpp>
 #include <pinocchio/algorithm/joint-configuration.hpp>
+#include <pinocchio/algorithm/kinematics.hpp>
+#include <pinocchio/algorithm/kinematics-derivatives.hpp>
 #include <pinocchio/algorithm/regressor.hpp>
 
 using namespace XBot;
 
 ModelInterface2Pin::ModelInterface2Pin(const ConfigOptions& opt):
     ModelInterface(opt),
-    _cached_computation(None),
-    _world_aligned(pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED)
+    _world_aligned(pinocchio::ReferenceFrame::LOCAL_WORLD_ALIGNED),
+    _float_kinematics(false),
+    _jac_full_sweep_threshold(3),
+    _contact_dim(0),
+    _contacts_version(1),
+    _mass(0.0),
+    _inertia_changed(false),
+    _incremental_kinematics(true)
 {
-    pinocchio::urdf::buildModel(std::const_pointer_cast<urdf::Model>(getUrdf()), _mdl);
+    opt.get_parameter("jacobian_full_sweep_threshold", _jac_full_sweep_threshold);
+
+    opt.get_parameter("incremental_kinematics", _incremental_kinematics);
 
-    _data = pinocchio::Data(_mdl);
+    std::string kin_precision = "double";
+
+    opt.get_parameter("kinematics_precision", kin_precision);
+
+    if(kin_precision == "float")
+    {
+        _float_kinematics = true;
+    }
+    else if(kin_precision != "double")
+    {
+        throw std::invalid_argument("invalid kinematics_precision '" + kin_precision +
+                                    "' (expected 'double' or 'float')");
+    }
 
-    _data_no_acc = pinocchio::Data(_mdl);
+    pinocchio::urdf::buildModel(std::const_pointer_cast<urdf::Model>(getUrdf()), _mdl);
 
     _mdl_orig = _mdl;
 
+    _mass = pinocchio::computeTotalMass(_mdl);
+
     _mdl_zerograv = _mdl;
 
     _mdl_zerograv.gravity = decltype(_mdl)::Motion::Zero();
 
     _qneutral = pinocchio::neutral(_mdl);
 
-    _tmp.resize(_mdl.nq, _mdl.nv);
+    _mdl_f = _mdl.cast<float>();
+
+    _ws = std::make_unique<WorkspacePin>(*this);
 
     _eye.setIdentity(_mdl.nv, _mdl.nv);
 
@@ -56,6 +86,7 @@ void ModelInterface2Pin::update_impl()
 
         // update placement
         _mdl.frames[ab.frame_idx].placement = ab.frame.placement;
+        _mdl_f.frames[ab.frame_idx].placement = ab.frame.placement.cast<float>();
     }
 
     for(const auto& [unused, ab] : _attached_body_map)
@@ -65,17 +96,239 @@ void ModelInterface2Pin::update_impl()
 
     }
 
-    // compute fk
-    pinocchio::forwardKinematics(_mdl, _data,
-                                 getJointPosition(),
-                                 getJointVelocity(),
-                                 getJointAcceleration());
+    // attached body inertias take effect here, so that the mass is
+    // recomputed eagerly and getMass() is a pure read (i.e. thread safe)
+    if(_inertia_changed)
+    {
+        _mass = pinocchio::computeTotalMass(_mdl);
+        _inertia_changed = false;
+    }
 
-    pinocchio::updateFramePlacements(_mdl, _data);
+    // record state, kinematics is computed lazily by the getters
+    _ws->set_state(getJointPosition(),
+                   getJointVelocity(),
+                   getJointAcceleration());
 
-    _cached_computation = Kinematics;
+    _ws->invalidate();
+}
 
+ModelInterface2Pin::State ModelInterface2Pin::model_state() const
+{
+    // note: effort is not part of the recorded state
+    return State{
+        _ws->getJointPosition(),
+        _ws->getJointVelocity(),
+        _ws->getJointAcceleration(),
+        getJointEffort()
+    };
+}
 
+ModelInterface::Workspace::UniquePtr ModelInterface2Pin::create_workspace_impl() const
+{
+    return std::make_unique<WorkspacePin>(*this);
+}
+
+void ModelInterface2Pin::update_workspace_impl(Workspace& ws) const
+{
+    workspace_cast(ws).invalidate();
+}
+
+ModelInterface2Pin::WorkspacePin& ModelInterface2Pin::workspace_cast(Workspace& ws) const
+{
+    auto pws = dynamic_cast<WorkspacePin*>(&ws);
+
+    if(!pws || pws->owner != this)
+    {
+        throw std::invalid_argument("workspace was not created by this model");
+    }
+
+    // data must be re-created if frames were added
+    if(int(pws->data.oMf.size()) != _mdl.nframes)
+    {
+        pws->reset_data(_mdl);
+    }
+
+    return *pws;
+}
+
+void ModelInterface2Pin::ensure_kinematics(WorkspacePin& ws, const State& s, uint32_t level) const
+{
+    bool position_computed = ws.cached_computation & KinematicsPosition;
+
+    // kinematics levels are cumulative
+    uint32_t required = KinematicsPosition;
+
+    if(level & KinematicsAcceleration)
+    {
+        required |= KinematicsVelocity | KinematicsAcceleration;
+    }
+    else if(level & KinematicsVelocity)
+    {
+        required |= KinematicsVelocity;
+    }
+
+    if((ws.cached_computation & required) != required)
+    {
+        if(_incremental_kinematics && (ws.kin_level & required) == required)
+        {
+            // note: higher levels stored inside data are kept up to date as well,
+            // so that they remain valid for subsequent requests
+            required = ws.kin_level;
+
+            forward_kinematics_incremental(ws, s, required);
+        }
+        else
+        {
+            if(required & KinematicsAcceleration)
+            {
+                pinocchio::forwardKinematics(_mdl, ws.data, s.q, s.v, s.a);
+            }
+            else if(required & KinematicsVelocity)
+            {
+                pinocchio::forwardKinematics(_mdl, ws.data, s.q, s.v);
+            }
+            else
+            {
+                pinocchio::forwardKinematics(_mdl, ws.data, s.q);
+            }
+
+            ws.stats.kinematics_full_pass++;
+        }
+
+        record_kinematics(ws, s, required);
+
+        ws.cached_computation |= required;
+    }
+
+    if(!position_computed)
+    {
+        update_hot_frames(ws);
+    }
+}
+
+void ModelInterface2Pin::forward_kinematics_incremental(WorkspacePin& ws, const State& s, uint32_t level) const
+{
+    // note: kinematics stored inside data must be valid (w.r.t. the
+    // recorded state) up to the requested level
+    bool velocity = level & KinematicsVelocity;
+    bool acceleration = level & KinematicsAcceleration;
+
+    // a joint must be updated if its own state changed, or if
+    // its parent was updated (joints are sorted topologically)
+    int n_dirty = 0;
+
+    for(pinocchio::JointIndex i = 1; i < _mdl.njoints; i++)
+    {
+        const auto& jm = _mdl.joints[i];
+
+        bool changed = s.q.segment(jm.idx_q(), jm.nq()) !=
+                       ws.kin_q.segment(jm.idx_q(), jm.nq());
+
+        if(velocity)
+        {
+            changed = changed || s.v.segment(jm.idx_v(), jm.nv()) !=
+                                     ws.kin_v.segment(jm.idx_v(), jm.nv());
+        }
+
+        if(acceleration)
+        {
+            changed = changed || s.a.segment(jm.idx_v(), jm.nv()) !=
+                                     ws.kin_a.segment(jm.idx_v(), jm.nv());
+        }
+
+        ws.kin_dirty[i] = changed || ws.kin_dirty[_mdl.parents[i]];
+
+        n_dirty += ws.kin_dirty[i];
+    }
+
+    // re-propagate the subtrees below changed joints, placements (and
+    // velocities, accelerations) elsewhere are still valid
+    using Pass0 = pinocchio::ForwardKinematicZeroStep<
+        double, 0, pinocchio::JointCollectionDefaultTpl, VecConstRef>;
+
+    using Pass1 = pinocchio::ForwardKinematicFirstStep<
+        double, 0, pinocchio::JointCollectionDefaultTpl, VecConstRef, VecConstRef>;
+
+    using Pass2 = pinocchio::ForwardKinematicSecondStep<
+        double, 0, pinocchio::JointCollectionDefaultTpl, VecConstRef, VecConstRef, VecConstRef>;
+
+    for(pinocchio::JointIndex i = 1; n_dirty > 0 && i < _mdl.njoints; i++)
+    {
+        if(!ws.kin_dirty[i])
+        {
+            continue;
+        }
+
+        if(acceleration)
+        {
+            Pass2::run(_mdl.joints[i], ws.data.joints[i],
+                       Pass2::ArgsType(_mdl, ws.data, s.q, s.v, s.a));
+        }
+        else if(velocity)
+        {
+            Pass1::run(_mdl.joints[i], ws.data.joints[i],
+                       Pass1::ArgsType(_mdl, ws.data, s.q, s.v));
+        }
+        else
+        {
+            Pass0::run(_mdl.joints[i], ws.data.joints[i],
+                       Pass0::ArgsType(_mdl, ws.data, s.q));
+        }
+    }
+
+    ws.stats.kinematics_incremental_pass++;
+    ws.stats.kinematics_incremental_joints += n_dirty;
+}
+
+void ModelInterface2Pin::record_kinematics(WorkspacePin& ws, const State& s, uint32_t level) const
+{
+    ws.kin_q = s.q;
+
+    if(level & KinematicsVelocity)
+    {
+        ws.kin_v = s.v;
+    }
+
+    if(level & KinematicsAcceleration)
+    {
+        ws.kin_a = s.a;
+    }
+
+    ws.kin_level = level;
+}
+
+void ModelInterface2Pin::ensure_frame_placement(WorkspacePin& ws, const State& s, int frame_idx) const
+{
+    if(ws.frame_stamp[frame_idx] != ws.stamp)
+    {
+        ensure_kinematics(ws, s, KinematicsPosition);
+        pinocchio::updateFramePlacement(_mdl, ws.data, frame_idx);
+        ws.frame_stamp[frame_idx] = ws.stamp;
+    }
+}
+
+void ModelInterface2Pin::update_hot_frames(WorkspacePin& ws) const
+{
+    for(auto frame_idx : _hot_frames)
+    {
+        pinocchio::updateFramePlacement(_mdl, ws.data, frame_idx);
+        ws.frame_stamp[frame_idx] = ws.stamp;
+    }
+}
+
+void ModelInterface2Pin::setHotLinks(const std::vector<int>& link_ids)
+{
+    for(int id : link_ids)
+    {
+        check_frame_idx_throw(id);
+    }
+
+    _hot_frames.assign(link_ids.begin(), link_ids.end());
+
+    std::sort(_hot_frames.begin(), _hot_frames.end());
+
+    _hot_frames.erase(std::unique(_hot_frames.begin(), _hot_frames.end()),
+                      _hot_frames.end());
 }
 
 int XBot::ModelInterface2Pin::getLinkId(string_const_ref link_name) const
@@ -91,49 +344,289 @@ int XBot::ModelInterface2Pin::getLinkId(string_const_ref link_name) const
 }
 
 Eigen::Affine3d ModelInterface2Pin::getPose(int frame_idx) const
+{
+    return get_pose(*_ws, model_state(), frame_idx);
+}
+
+Eigen::Affine3d ModelInterface2Pin::getPose(Workspace& ws, int frame_idx) const
+{
+    auto& pws = workspace_cast(ws);
+    return get_pose(pws, pws.state(), frame_idx);
+}
+
+Eigen::Affine3d ModelInterface2Pin::get_pose(WorkspacePin& ws, const State& s, int frame_idx) const
 {
     check_frame_idx_throw(frame_idx);
 
+    if(_float_kinematics)
+    {
+        return get_pose_f(ws, s, frame_idx);
+    }
+
+    ensure_frame_placement(ws, s, frame_idx);
+
     Eigen::Affine3d ret;
-    ret.translation() = _data.oMf.at(frame_idx).translation();
-    ret.linear() = _data.oMf.at(frame_idx).rotation();
+    ret.translation() = ws.data.oMf.at(frame_idx).translation();
+    ret.linear() = ws.data.oMf.at(frame_idx).rotation();
     return ret;
 }
 
 void ModelInterface2Pin::getJacobian(int link_id, MatRef J) const
 {
-    check_frame_idx_throw(link_id);
+    get_jacobian(*_ws, model_state(), link_id, _world_aligned, J);
+}
+
+void ModelInterface2Pin::getJacobian(Workspace& ws, int link_id, MatRef J) const
+{
+    auto& pws = workspace_cast(ws);
+    get_jacobian(pws, pws.state(), link_id, _world_aligned, J);
+}
+
+void ModelInterface2Pin::getJacobianInWorld(int link_id, MatRef J) const
+{
+    get_jacobian(*_ws, model_state(), link_id, pinocchio::ReferenceFrame::WORLD, J);
+}
+
+void ModelInterface2Pin::get_jacobian(WorkspacePin& ws, const State& s,
+                                      int frame_idx,
+                                      pinocchio::ReferenceFrame rf,
+                                      MatRef J) const
+{
+    check_frame_idx_throw(frame_idx);
 
-    if(!(_cached_computation & Jacobians))
+    count_jacobian_request(ws, frame_idx);
+
+    if(_float_kinematics)
     {
-        pinocchio::computeJointJacobians(_mdl, _data, getJointPosition());
-        _cached_computation |= Jacobians;
+        return get_jacobian_f(ws, s, frame_idx, rf, J);
     }
 
     J.setZero();
 
-    pinocchio::getFrameJacobian(_mdl, _data, link_id, _world_aligned, J);
+    if(!is_cached(ws, Jacobians))
+    {
+        // few jacobians are expected: only traverse the
+        // frame's support path
+        if(!jacobian_full_sweep(ws))
+        {
+            pinocchio::computeFrameJacobian(_mdl, ws.data, s.q, frame_idx, rf, J);
+            ws.overwrite(KinematicsPosition);
+            ws.stats.jacobian_single_frame++;
+            return;
+        }
+
+        // note: joint jacobians are computed from the
+        // (possibly incrementally updated) joint placements
+        ensure_kinematics(ws, s, KinematicsPosition);
+
+        pinocchio::computeJointJacobians(_mdl, ws.data);
+
+        ws.cached_computation |= Jacobians;
+        ws.stats.jacobian_full_sweep++;
+    }
+
+    ws.stats.jacobian_from_full_sweep++;
+
+    pinocchio::getFrameJacobian(_mdl, ws.data, frame_idx, rf, J);
 }
 
-void ModelInterface2Pin::getJacobianInWorld(int link_id, MatRef J) const
+void ModelInterface2Pin::count_jacobian_request(WorkspacePin& ws, int frame_idx) const
+{
+    // count distinct jacobians requested during this cycle
+    if(ws.jac_stamp[frame_idx] != ws.stamp)
+    {
+        ws.jac_stamp[frame_idx] = ws.stamp;
+        ws.n_jac_requests++;
+    }
+}
+
+bool ModelInterface2Pin::jacobian_full_sweep(const WorkspacePin& ws) const
 {
-    check_frame_idx_throw(link_id);
+    return ws.n_jac_requests_prev >= _jac_full_sweep_threshold ||
+           ws.n_jac_requests >= _jac_full_sweep_threshold;
+}
 
-    if(!(_cached_computation & Jacobians))
+Eigen::Affine3d ModelInterface2Pin::get_pose_f(WorkspacePin& ws, const State& s, int frame_idx) const
+{
+    if(!is_cached(ws, KinematicsPositionFloat))
     {
-        pinocchio::computeJointJacobians(_mdl, _data, getJointPosition());
-        _cached_computation |= Jacobians;
+        ws.tmp.q_f = s.q.cast<float>();
+        pinocchio::forwardKinematics(_mdl_f, ws.data_f, ws.tmp.q_f);
+        ws.cached_computation |= KinematicsPositionFloat;
     }
 
-    J.setZero();
+    const auto& oMf = pinocchio::updateFramePlacement(_mdl_f, ws.data_f, frame_idx);
+
+    Eigen::Affine3d ret;
+    ret.translation() = oMf.translation().cast<double>();
+    ret.linear() = oMf.rotation().cast<double>();
+    return ret;
+}
 
-    pinocchio::getFrameJacobian(_mdl, _data, link_id, pinocchio::ReferenceFrame::WORLD, J);
+void ModelInterface2Pin::get_jacobian_f(WorkspacePin& ws, const State& s,
+                                        int frame_idx,
+                                        pinocchio::ReferenceFrame rf,
+                                        MatRef J) const
+{
+    ws.tmp.J_f.setZero();
+
+    // same single frame / full sweep policy as the double precision path
+    if(!is_cached(ws, JacobiansFloat))
+    {
+        ws.tmp.q_f = s.q.cast<float>();
+
+        if(!jacobian_full_sweep(ws))
+        {
+            // note: placements along the support path are recomputed
+            // at the same configuration, cached ones stay valid
+            pinocchio::computeFrameJacobian(_mdl_f, ws.data_f, ws.tmp.q_f, frame_idx, rf, ws.tmp.J_f);
+            ws.stats.jacobian_single_frame++;
+
+            J = ws.tmp.J_f.cast<double>();
+            return;
+        }
+
+        pinocchio::computeJointJacobians(_mdl_f, ws.data_f, ws.tmp.q_f);
+        ws.cached_computation |= KinematicsPositionFloat | JacobiansFloat;
+        ws.stats.jacobian_full_sweep++;
+    }
+
+    ws.stats.jacobian_from_full_sweep++;
+
+    pinocchio::getFrameJacobian(_mdl_f, ws.data_f, frame_idx, rf, ws.tmp.J_f);
+
+    J = ws.tmp.J_f.cast<double>();
+}
+
+bool ModelInterface2Pin::is_cached(WorkspacePin& ws, ComputationType c, bool valid) const
+{
+    int bit = std::countr_zero(static_cast<uint32_t>(c));
+
+    if((ws.cached_computation & c) && valid)
+    {
+        ws.stats.cache_hit[bit]++;
+        return true;
+    }
+
+    ws.stats.cache_miss[bit]++;
+    return false;
 }
 
+bool ModelInterface2Pin::is_cached_for_effort(WorkspacePin& ws, ComputationType c,
+                                              const State& s, Eigen::VectorXd& tau_slot) const
+{
+    if(is_cached(ws, c, s.tau == tau_slot))
+    {
+        return true;
+    }
+
+    tau_slot = s.tau;
+    return false;
+}
+
+const char * ModelInterface2Pin::computation_name(int bit)
+{
+    static const char * names[] = {
+        "kinematics_position",
+        "kinematics_velocity",
+        "kinematics_acceleration",
+        "kinematics_no_acc",
+        "jacobians",
+        "rnea",
+        "gcomp",
+        "nonlinear_effects",
+        "com",
+        "com_no_acc",
+        "crba",
+        "minv",
+        "ccrba",
+        "jacobians_time_variation",
+        "rnea_derivatives",
+        "aba_derivatives",
+        "kinematics_derivatives",
+        "cholesky",
+        "constrained_dynamics",
+        "regressor",
+        "kinematics_position_float",
+        "jacobians_float",
+        "com_jacobian",
+        "forward_dynamics",
+        "dccrba",
+        "centroidal_derivatives",
+    };
+
+    if(bit < 0 || bit >= std::size(names))
+    {
+        return nullptr;
+    }
+
+    return names[bit];
+}
+
+std::map<std::string, uint64_t> ModelInterface2Pin::getComputationStatistics() const
+{
+    std::map<std::string, uint64_t> ret = {
+        {"jacobian_single_frame", _ws->stats.jacobian_single_frame},
+        {"jacobian_full_sweep", _ws->stats.jacobian_full_sweep},
+        {"jacobian_from_full_sweep", _ws->stats.jacobian_from_full_sweep},
+        {"kinematics_full_pass", _ws->stats.kinematics_full_pass},
+        {"kinematics_incremental_pass", _ws->stats.kinematics_incremental_pass},
+        {"kinematics_incremental_joints", _ws->stats.kinematics_incremental_joints}
+    };
+
+    // cache hit/miss counters of all memoized computations
+    for(int i = 0; computation_name(i); i++)
+    {
+        std::string name = computation_name(i);
+        ret[name + "_hit"] = _ws->stats.cache_hit[i];
+        ret[name + "_miss"] = _ws->stats.cache_miss[i];
+    }
+
+    return ret;
+}
+
+void ModelInterface2Pin::resetComputationStatistics()
+{
+    _ws->stats = Statistics();
+}
+
+
+Eigen::VectorXd ModelInterface2Pin::getDynamicParameters() const
+{
+    Eigen::VectorXd pi(10*(_mdl.njoints - 1));
+
+    for(int i = 1; i < _mdl.njoints; i++)
+    {
+        pi.segment<10>(10*(i - 1)) = _mdl.inertias[i].toDynamicParameters();
+    }
+
+    return pi;
+}
 
 MatConstRef ModelInterface2Pin::computeRegressor() const
 {
-    throw NotImplemented(__PRETTY_FUNCTION__);
+    return compute_regressor(*_ws, model_state());
+}
+
+MatConstRef ModelInterface2Pin::computeRegressor(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_regressor(pws, pws.state());
+}
+
+MatConstRef ModelInterface2Pin::compute_regressor(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Regressor))
+    {
+        pinocchio::computeJointTorqueRegressor(_mdl, ws.data, s.q, s.v, s.a);
+
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration);
+
+        ws.cached_computation |= Regressor;
+    }
+
+    return ws.data.jointTorqueRegressor;
 }
 
 void ModelInterface2Pin::sum(VecConstRef q0, VecConstRef v, Eigen::VectorXd& q1) const
@@ -190,7 +683,11 @@ int ModelInterface2Pin::addFixedLink(string_const_ref link_name,
 
     _attached_body_map[ab.frame_idx] = ab;
 
-    _data = pinocchio::Data(_mdl);
+    _inertia_changed = true;
+
+    _mdl_f = _mdl.cast<float>();
+
+    _ws->reset_data(_mdl);
 
     return ab.frame_idx;
 
@@ -207,6 +704,8 @@ bool ModelInterface2Pin::updateFixedLink(int link_id, double mass, Eigen::Matrix
     ab.frame.placement.translation() = m_pose.translation();
     ab.frame.placement.rotation() = m_pose.linear();
 
+    _inertia_changed = true;
+
     return true;  // TBD check mass and inertia
 }
 
@@ -369,115 +868,459 @@ void ModelInterface2Pin::check_frame_idx_throw(int idx) const
     }
 }
 
+void ModelInterface2Pin::check_mat_size(MatConstRef mat, int rows, int cols, const char * func)
+{
+    if(mat.rows() != rows || mat.cols() != cols)
+    {
+        throw std::out_of_range("size mismatch in " + std::string(func) + ": " +
+                                std::to_string(mat.rows()) + " x " + std::to_string(mat.cols()) +
+                                " (actual) != " +
+                                std::to_string(rows) + " x " + std::to_string(cols) +
+                                " (expected)");
+    }
+}
+
 void ModelInterface2Pin::Temporaries::resize(int nq, int nv)
 {
     J.setZero(6, nv);
     qsum.setZero(nq);
     h = gcomp = rnea.setZero(nv);
     qdiff.setZero(nv);
+    q_f.setZero(nq);
+    J_f.setZero(6, nv);
+    dv_dq.setZero(6, nv);
+    dv_dv.setZero(6, nv);
+    aba_derivatives_tau.setZero(nv);
+    dh_dq.setZero(6, nv);
+    dhdot_dq.setZero(6, nv);
+    dhdot_dv.setZero(6, nv);
+    dhdot_da.setZero(6, nv);
+    aba_ddq.setZero(nv);
+    aba_tau.setZero(nv);
+    constrained_ddq.setZero(nv);
+    constrained_dynamics_tau.setZero(nv);
 }
 
-Eigen::Vector6d XBot::ModelInterface2Pin::getVelocityTwist(int frame_idx) const
+ModelInterface2Pin::WorkspacePin::WorkspacePin(const ModelInterface2Pin& model):
+    owner(&model),
+    data(model._mdl),
+    data_no_acc(model._mdl),
+    data_f(model._mdl_f),
+    cached_computation(None),
+    stamp(1),
+    frame_stamp(model._mdl.nframes, 0),
+    jac_stamp(model._mdl.nframes, 0),
+    n_jac_requests(0),
+    n_jac_requests_prev(0),
+    contacts_version(0),
+    kin_level(None),
+    kin_dirty(model._mdl.njoints, 0)
 {
-    check_frame_idx_throw(frame_idx);
+    tmp.resize(model._mdl.nq, model._mdl.nv);
+
+    kin_q.setZero(model._mdl.nq);
+    kin_v.setZero(model._mdl.nv);
+    kin_a.setZero(model._mdl.nv);
 
-    auto v = pinocchio::getFrameVelocity(_mdl, _data, frame_idx, _world_aligned);
+    _q = model._qneutral;
+    _v.setZero(model._mdl.nv);
+    _a.setZero(model._mdl.nv);
+    _tau.setZero(model._mdl.nv);
+}
+
+ModelInterface2Pin::State ModelInterface2Pin::WorkspacePin::state() const
+{
+    return State{
+        getJointPosition(),
+        getJointVelocity(),
+        getJointAcceleration(),
+        getJointEffort()
+    };
+}
+
+void ModelInterface2Pin::WorkspacePin::set_state(VecConstRef q, VecConstRef v, VecConstRef a)
+{
+    _q = q;
+    _v = v;
+    _a = a;
+}
+
+void ModelInterface2Pin::WorkspacePin::invalidate()
+{
+    cached_computation = None;
+    stamp++;
+    n_jac_requests_prev = n_jac_requests;
+    n_jac_requests = 0;
+}
+
+void ModelInterface2Pin::WorkspacePin::discard(uint32_t computation)
+{
+    cached_computation &= ~computation;
+    kin_level &= ~computation;
+}
+
+void ModelInterface2Pin::WorkspacePin::overwrite(uint32_t computation)
+{
+    kin_level &= ~(computation & ~cached_computation);
+}
+
+void ModelInterface2Pin::WorkspacePin::reset_data(const pinocchio::Model& mdl)
+{
+    data = pinocchio::Data(mdl);
+    data_no_acc = pinocchio::Data(mdl);
+    data_f = pinocchio::DataTpl<float>(owner->_mdl_f);
+    frame_stamp.assign(mdl.nframes, 0);
+    jac_stamp.assign(mdl.nframes, 0);
+    contacts_version = 0;
+    kin_level = None;
+    invalidate();
+}
+
+Eigen::Vector6d ModelInterface2Pin::getVelocityTwist(int frame_idx) const
+{
+    return get_velocity_twist(*_ws, model_state(), frame_idx, _world_aligned);
+}
 
-    return v;
+Eigen::Vector6d ModelInterface2Pin::getVelocityTwist(Workspace& ws, int frame_idx) const
+{
+    auto& pws = workspace_cast(ws);
+    return get_velocity_twist(pws, pws.state(), frame_idx, _world_aligned);
+}
+
+Eigen::Vector6d ModelInterface2Pin::getVelocityTwistInWorld(int frame_idx) const
+{
+    return get_velocity_twist(*_ws, model_state(), frame_idx, pinocchio::ReferenceFrame::WORLD);
 }
 
-Eigen::Vector6d XBot::ModelInterface2Pin::getVelocityTwistInWorld(int frame_idx) const
+Eigen::Vector6d ModelInterface2Pin::get_velocity_twist(WorkspacePin& ws,
+                                                       const State& s,
+                                                       int frame_idx,
+                                                       pinocchio::ReferenceFrame rf) const
 {
     check_frame_idx_throw(frame_idx);
 
-    return pinocchio::getFrameVelocity(_mdl, _data, frame_idx, pinocchio::ReferenceFrame::WORLD);
+    ensure_kinematics(ws, s, KinematicsVelocity);
+
+    return pinocchio::getFrameVelocity(_mdl, ws.data, frame_idx, rf);
 }
 
 Eigen::Vector6d ModelInterface2Pin::getAccelerationTwist(int frame_idx) const
 {
-    check_frame_idx_throw(frame_idx);
+    return get_acceleration_twist(*_ws, model_state(), frame_idx, _world_aligned);
+}
 
-    return pinocchio::getFrameClassicalAcceleration(_mdl, _data, frame_idx, _world_aligned);
+Eigen::Vector6d ModelInterface2Pin::getAccelerationTwist(Workspace& ws, int frame_idx) const
+{
+    auto& pws = workspace_cast(ws);
+    return get_acceleration_twist(pws, pws.state(), frame_idx, _world_aligned);
+}
+
+Eigen::Vector6d ModelInterface2Pin::getAccelerationTwistInWorld(int frame_idx) const
+{
+    return get_acceleration_twist(*_ws, model_state(), frame_idx, pinocchio::ReferenceFrame::WORLD);
 }
 
-Eigen::Vector6d XBot::ModelInterface2Pin::getAccelerationTwistInWorld(int frame_idx) const
+Eigen::Vector6d ModelInterface2Pin::get_acceleration_twist(WorkspacePin& ws,
+                                                           const State& s,
+                                                           int frame_idx,
+                                                           pinocchio::ReferenceFrame rf) const
 {
     check_frame_idx_throw(frame_idx);
 
-    return pinocchio::getFrameClassicalAcceleration(_mdl, _data, frame_idx, pinocchio::ReferenceFrame::WORLD);
+    ensure_kinematics(ws, s, KinematicsAcceleration);
+
+    return pinocchio::getFrameClassicalAcceleration(_mdl, ws.data, frame_idx, rf);
 }
 
 Eigen::Vector6d ModelInterface2Pin::getJdotTimesV(int frame_idx) const
+{
+    return get_jdot_times_v(*_ws, model_state(), frame_idx);
+}
+
+Eigen::Vector6d ModelInterface2Pin::getJdotTimesV(Workspace& ws, int frame_idx) const
+{
+    auto& pws = workspace_cast(ws);
+    return get_jdot_times_v(pws, pws.state(), frame_idx);
+}
+
+Eigen::Vector6d ModelInterface2Pin::get_jdot_times_v(WorkspacePin& ws,
+                                                     const State& s,
+                                                     int frame_idx) const
 {
     check_frame_idx_throw(frame_idx);
 
-    if(!(_cached_computation & KinematicsNoAcc))
+    if(!is_cached(ws, KinematicsNoAcc))
     {
-        pinocchio::forwardKinematics(_mdl, _data_no_acc, getJointPosition(), getJointVelocity(), _vzero);
-        _cached_computation |= KinematicsNoAcc;
+        pinocchio::forwardKinematics(_mdl, ws.data_no_acc, s.q, s.v, _vzero);
+        ws.cached_computation |= KinematicsNoAcc;
     }
 
-    return pinocchio::getFrameClassicalAcceleration(_mdl, _data_no_acc, frame_idx, _world_aligned);
+    return pinocchio::getFrameClassicalAcceleration(_mdl, ws.data_no_acc, frame_idx, _world_aligned);
 }
 
-double ModelInterface2Pin::getMass() const
+void ModelInterface2Pin::getJacobianTimeVariation(int frame_idx, MatRef dJ) const
 {
-    return pinocchio::computeTotalMass(_mdl);
+    get_jacobian_time_variation(*_ws, model_state(), frame_idx, dJ);
 }
 
-Eigen::Vector3d ModelInterface2Pin::getCOM() const
+void ModelInterface2Pin::getJacobianTimeVariation(Workspace& ws, int frame_idx, MatRef dJ) const
+{
+    auto& pws = workspace_cast(ws);
+    get_jacobian_time_variation(pws, pws.state(), frame_idx, dJ);
+}
+
+void ModelInterface2Pin::get_jacobian_time_variation(WorkspacePin& ws,
+                                                     const State& s,
+                                                     int frame_idx,
+                                                     MatRef dJ) const
 {
-    if(!(_cached_computation & Com))
+    check_frame_idx_throw(frame_idx);
+
+    if(!is_cached(ws, JacobiansTimeVariation))
     {
-        pinocchio::centerOfMass(_mdl, _data, pinocchio::KinematicLevel::ACCELERATION, false);
-        _cached_computation |= Com;
+        // note: this includes a position-level kinematics pass and
+        // the joint jacobians
+        pinocchio::computeJointJacobiansTimeVariation(_mdl, ws.data, s.q, s.v);
+
+        // note: joint velocities are also overwritten
+        if(!(ws.cached_computation & KinematicsVelocity))
+        {
+            record_kinematics(ws, s, KinematicsPosition | KinematicsVelocity);
+        }
+
+        if(!(ws.cached_computation & KinematicsPosition))
+        {
+            ws.cached_computation |= KinematicsPosition;
+            update_hot_frames(ws);
+        }
+
+        ws.cached_computation |= Jacobians | JacobiansTimeVariation;
     }
 
-    return _data.com[0];
+    dJ.setZero();
+
+    // note: this also updates the frame placement
+    pinocchio::getFrameJacobianTimeVariation(_mdl, ws.data, frame_idx, _world_aligned, dJ);
+
+    ws.frame_stamp[frame_idx] = ws.stamp;
 }
 
-Eigen::Vector3d ModelInterface2Pin::getCOMVelocity() const
+void ModelInterface2Pin::ensure_kinematics_derivatives(WorkspacePin& ws, const State& s) const
 {
-    if(!(_cached_computation & Com))
+    if(ws.cached_computation & KinematicsDerivatives)
     {
-        pinocchio::centerOfMass(_mdl, _data, pinocchio::KinematicLevel::ACCELERATION, false);
-        _cached_computation |= Com;
+        return;
     }
 
-    return _data.vcom[0];
+    bool position_computed = ws.cached_computation & KinematicsPosition;
+
+    // note: this includes a full forward kinematics pass
+    pinocchio::computeForwardKinematicsDerivatives(_mdl, ws.data, s.q, s.v, s.a);
+
+    record_kinematics(ws, s, KinematicsPosition | KinematicsVelocity | KinematicsAcceleration);
+
+    ws.cached_computation |= KinematicsDerivatives |
+                             KinematicsPosition |
+                             KinematicsVelocity |
+                             KinematicsAcceleration;
+
+    if(!position_computed)
+    {
+        update_hot_frames(ws);
+    }
+}
+
+void ModelInterface2Pin::getVelocityTwistDerivatives(int frame_idx,
+                                                     MatRef dv_dq,
+                                                     MatRef dv_dv) const
+{
+    get_velocity_twist_derivatives(*_ws, model_state(), frame_idx, dv_dq, dv_dv);
+}
+
+void ModelInterface2Pin::getVelocityTwistDerivatives(Workspace& ws,
+                                                     int frame_idx,
+                                                     MatRef dv_dq,
+                                                     MatRef dv_dv) const
+{
+    auto& pws = workspace_cast(ws);
+    get_velocity_twist_derivatives(pws, pws.state(), frame_idx, dv_dq, dv_dv);
+}
+
+void ModelInterface2Pin::get_velocity_twist_derivatives(WorkspacePin& ws,
+                                                        const State& s,
+                                                        int frame_idx,
+                                                        MatRef dv_dq,
+                                                        MatRef dv_dv) const
+{
+    check_frame_idx_throw(frame_idx);
+
+    ensure_kinematics_derivatives(ws, s);
+
+    // note: only the columns in the frame support are written
+    dv_dq.setZero();
+    dv_dv.setZero();
+
+    pinocchio::getFrameVelocityDerivatives(_mdl, ws.data, frame_idx, _world_aligned,
+                                           dv_dq, dv_dv);
+
+    // note: this also updates the frame placement
+    ws.frame_stamp[frame_idx] = ws.stamp;
+}
+
+void ModelInterface2Pin::getAccelerationTwistDerivatives(int frame_idx,
+                                                         MatRef da_dq,
+                                                         MatRef da_dv,
+                                                         MatRef da_da) const
+{
+    get_acceleration_twist_derivatives(*_ws, model_state(), frame_idx, da_dq, da_dv, da_da);
+}
+
+void ModelInterface2Pin::getAccelerationTwistDerivatives(Workspace& ws,
+                                                         int frame_idx,
+                                                         MatRef da_dq,
+                                                         MatRef da_dv,
+                                                         MatRef da_da) const
+{
+    auto& pws = workspace_cast(ws);
+    get_acceleration_twist_derivatives(pws, pws.state(), frame_idx, da_dq, da_dv, da_da);
+}
+
+void ModelInterface2Pin::get_acceleration_twist_derivatives(WorkspacePin& ws,
+                                                            const State& s,
+                                                            int frame_idx,
+                                                            MatRef da_dq,
+                                                            MatRef da_dv,
+                                                            MatRef da_da) const
+{
+    check_frame_idx_throw(frame_idx);
+
+    ensure_kinematics_derivatives(ws, s);
+
+    auto& dv_dq = ws.tmp.dv_dq;
+    auto& dv_dv = ws.tmp.dv_dv;
+
+    // note: only the columns in the frame support are written
+    dv_dq.setZero();
+    dv_dv.setZero();
+    da_dq.setZero();
+    da_dv.setZero();
+    da_da.setZero();
+
+    pinocchio::getFrameVelocityDerivatives(_mdl, ws.data, frame_idx, _world_aligned,
+                                           dv_dq, dv_dv);
+
+    pinocchio::getFrameAccelerationDerivatives(_mdl, ws.data, frame_idx, _world_aligned,
+                                               dv_dq, da_dq, da_dv, da_da);
+
+    ws.frame_stamp[frame_idx] = ws.stamp;
+
+    // pinocchio returns derivatives of the spatial acceleration, whereas
+    // getAccelerationTwist returns the classical one, i.e.
+    // a_lin_classical = a_lin + w x v_lin
+    pinocchio::Motion vel = pinocchio::getFrameVelocity(_mdl, ws.data, frame_idx, _world_aligned);
+
+    Eigen::Matrix3d S_w = Utils::skew(vel.angular());
+    Eigen::Matrix3d S_v = Utils::skew(vel.linear());
+
+    da_dq.topRows<3>().noalias() += S_w * dv_dq.topRows<3>();
+    da_dq.topRows<3>().noalias() -= S_v * dv_dq.bottomRows<3>();
+    da_dv.topRows<3>().noalias() += S_w * dv_dv.topRows<3>();
+    da_dv.topRows<3>().noalias() -= S_v * dv_dv.bottomRows<3>();
+}
+
+double ModelInterface2Pin::getMass() const
+{
+    // note: the mass does not depend on the state, it is computed
+    // on construction and by update_impl() when attached bodies change
+    return _mass;
+}
+
+Eigen::Vector3d ModelInterface2Pin::getCOM() const
+{
+    compute_com(*_ws, model_state());
+
+    return _ws->data.com[0];
+}
+
+Eigen::Vector3d ModelInterface2Pin::getCOM(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+
+    compute_com(pws, pws.state());
+
+    return pws.data.com[0];
+}
+
+Eigen::Vector3d ModelInterface2Pin::getCOMVelocity() const
+{
+    compute_com(*_ws, model_state());
+
+    return _ws->data.vcom[0];
 }
 
 Eigen::Vector3d ModelInterface2Pin::getCOMAcceleration() const
 {
-    if(!(_cached_computation & Com))
+    compute_com(*_ws, model_state());
+
+    return _ws->data.acom[0];
+}
+
+void ModelInterface2Pin::compute_com(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Com))
     {
-        pinocchio::centerOfMass(_mdl, _data, pinocchio::KinematicLevel::ACCELERATION, false);
-        _cached_computation |= Com;
+        ensure_kinematics(ws, s, KinematicsAcceleration);
+        pinocchio::centerOfMass(_mdl, ws.data, pinocchio::KinematicLevel::ACCELERATION, false);
+        ws.cached_computation |= Com;
     }
-
-    return _data.acom[0];
 }
 
 void ModelInterface2Pin::getCOMJacobian(MatRef J) const
 {
-    J = pinocchio::jacobianCenterOfMass(_mdl, _data, false);
+    get_com_jacobian(*_ws, model_state(), J);
+}
+
+void ModelInterface2Pin::getCOMJacobian(Workspace& ws, MatRef J) const
+{
+    auto& pws = workspace_cast(ws);
+    get_com_jacobian(pws, pws.state(), J);
+}
+
+void ModelInterface2Pin::get_com_jacobian(WorkspacePin& ws, const State& s, MatRef J) const
+{
+    if(!is_cached(ws, ComJacobian))
+    {
+        ensure_kinematics(ws, s, KinematicsPosition);
+
+        // note: result is stored inside data.Jcom
+        pinocchio::jacobianCenterOfMass(_mdl, ws.data, false);
+
+        ws.cached_computation |= ComJacobian;
+    }
+
+    J = ws.data.Jcom;
 }
 
 Eigen::Vector3d ModelInterface2Pin::getCOMJdotTimesV() const
 {
-    if(!(_cached_computation & KinematicsNoAcc))
+    return get_com_jdot_times_v(*_ws, model_state());
+}
+
+Eigen::Vector3d ModelInterface2Pin::get_com_jdot_times_v(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, KinematicsNoAcc))
     {
-        pinocchio::forwardKinematics(_mdl, _data_no_acc, getJointPosition(), getJointVelocity(), _vzero);
-        _cached_computation |= KinematicsNoAcc;
+        pinocchio::forwardKinematics(_mdl, ws.data_no_acc, s.q, s.v, _vzero);
+        ws.cached_computation |= KinematicsNoAcc;
     }
 
-    if(!(_cached_computation & ComNoAcc))
+    if(!is_cached(ws, ComNoAcc))
     {
-        pinocchio::centerOfMass(_mdl, _data_no_acc, pinocchio::KinematicLevel::ACCELERATION, false);
-        _cached_computation |= ComNoAcc;
+        pinocchio::centerOfMass(_mdl, ws.data_no_acc, pinocchio::KinematicLevel::ACCELERATION, false);
+        ws.cached_computation |= ComNoAcc;
     }
 
-    return _data.acom[0];
+    return ws.data_no_acc.acom[0];
 }
 
 XBOT2_REGISTER_MODEL_PLUGIN(ModelInterface2Pin, pin);
@@ -5,12 +5,16 @@
 #include <pinocchio/multibody/model.hpp>
 #include <pinocchio/multibody/data.hpp>
 #include <pinocchio/parsers/urdf.hpp>
+#include <pinocchio/algorithm/contact-info.hpp>
 
 #include <xbot2_interface/xbotinterface2.h>
 
+#include <array>
+
 namespace XBot {
 
-class ModelInterface2Pin : public ModelInterface
+// note: exported, so that derived backends (e.g. pin_cg) can link to it
+class XBOT2IFC_HELPER_DLL_EXPORT ModelInterface2Pin : public ModelInterface
 {
 
 public:
@@ -23,48 +27,140 @@ public:
 
     int getLinkId(string_const_ref link_name) const override;
 
+    using ModelInterface::setHotLinks;
+    void setHotLinks(const std::vector<int>& link_ids) override;
+
+    std::map<std::string, uint64_t> getComputationStatistics() const override;
+
+    void resetComputationStatistics() override;
+
     Eigen::Affine3d getPose(int link_id) const override;
+    Eigen::Affine3d getPose(Workspace& ws, int link_id) const override;
 
     void getJacobian(int link_id, MatRef J) const override;
+    void getJacobian(Workspace& ws, int link_id, MatRef J) const override;
     void getJacobianInWorld(int link_id, MatRef J) const override;
 
     Eigen::Vector6d getVelocityTwist(int link_id) const override;
+    Eigen::Vector6d getVelocityTwist(Workspace& ws, int link_id) const override;
     Eigen::Vector6d getVelocityTwistInWorld(int link_id) const override;
 
     Eigen::Vector6d getAccelerationTwist(int link_id) const override;
+    Eigen::Vector6d getAccelerationTwist(Workspace& ws, int link_id) const override;
     Eigen::Vector6d getAccelerationTwistInWorld(int link_id) const override;
 
     Eigen::Vector6d getJdotTimesV(int link_id) const override;
+    Eigen::Vector6d getJdotTimesV(Workspace& ws, int link_id) const override;
+
+    void getJacobianTimeVariation(int link_id, MatRef dJ) const override;
+    void getJacobianTimeVariation(Workspace& ws, int link_id, MatRef dJ) const override;
+
+    void getVelocityTwistDerivatives(int link_id,
+                                     MatRef dv_dq,
+                                     MatRef dv_dv) const override;
+    void getVelocityTwistDerivatives(Workspace& ws,
+                                     int link_id,
+                                     MatRef dv_dq,
+                                     MatRef dv_dv) const override;
+
+    void getAccelerationTwistDerivatives(int link_id,
+                                         MatRef da_dq,
+                                         MatRef da_dv,
+                                         MatRef da_da) const override;
+    void getAccelerationTwistDerivatives(Workspace& ws,
+                                         int link_id,
+                                         MatRef da_dq,
+                                         MatRef da_dv,
+                                         MatRef da_da) const override;
 
     double getMass() const override;
 
     Eigen::Vector3d getCOM() const override;
+    Eigen::Vector3d getCOM(Workspace& ws) const override;
 
     Eigen::Vector3d getCOMVelocity() const override;
 
     Eigen::Vector3d getCOMAcceleration() const override;
 
     void getCOMJacobian(MatRef J) const override;
+    void getCOMJacobian(Workspace& ws, MatRef J) const override;
 
     Eigen::Vector3d getCOMJdotTimesV() const override;
 
     VecConstRef computeInverseDynamics() const override;
+    VecConstRef computeInverseDynamics(Workspace& ws) const override;
 
     VecConstRef computeGravityCompensation() const override;
+    VecConstRef computeGravityCompensation(Workspace& ws) const override;
 
     VecConstRef computeForwardDynamics() const override;
+    VecConstRef computeForwardDynamics(Workspace& ws) const override;
 
     MatConstRef computeInertiaMatrix() const override;
+    MatConstRef computeInertiaMatrix(Workspace& ws) const override;
 
     MatConstRef computeCentroidalMomentumMatrix() const override;
+    MatConstRef computeCentroidalMomentumMatrix(Workspace& ws) const override;
 
     Eigen::Vector6d computeCentroidalMomentum() const override;
 
+    MatConstRef computeCentroidalMomentumMatrixTimeVariation() const override;
+    MatConstRef computeCentroidalMomentumMatrixTimeVariation(Workspace& ws) const override;
+
+    void computeCentroidalDynamicsDerivatives(MatRef dh_dq,
+                                              MatRef dhdot_dq,
+                                              MatRef dhdot_dv,
+                                              MatRef dhdot_da) const override;
+    void computeCentroidalDynamicsDerivatives(Workspace& ws,
+                                              MatRef dh_dq,
+                                              MatRef dhdot_dq,
+                                              MatRef dhdot_dv,
+                                              MatRef dhdot_da) const override;
+
     MatConstRef computeInertiaInverse() const override;
+    MatConstRef computeInertiaInverse(Workspace& ws) const override;
+
+    void computeInertiaInverseTimes(MatConstRef B, MatRef MinvB) const override;
+    void computeInertiaInverseTimes(Workspace& ws, MatConstRef B, MatRef MinvB) const override;
+
+    void computeInverseOperationalSpaceInertia(MatConstRef J, MatRef Linv) const override;
+    void computeInverseOperationalSpaceInertia(Workspace& ws, MatConstRef J, MatRef Linv) const override;
 
     VecConstRef computeNonlinearTerm() const override;
+    VecConstRef computeNonlinearTerm(Workspace& ws) const override;
 
-    MatConstRef computeRegressor() const;
+    void computeInverseDynamicsDerivatives(MatRef dtau_dq,
+                                           MatRef dtau_dv,
+                                           MatRef dtau_da) const override;
+    void computeInverseDynamicsDerivatives(Workspace& ws,
+                                           MatRef dtau_dq,
+                                           MatRef dtau_dv,
+                                           MatRef dtau_da) const override;
+
+    using ModelInterface::setContacts;
+    void setContacts(const std::vector<int>& link_ids,
+                     const std::vector<ContactType>& types) override;
+
+    int getContactDimension() const override;
+
+    void computeConstrainedDynamics(VecRef ddq, VecRef lambda) const override;
+    void computeConstrainedDynamics(Workspace& ws, VecRef ddq, VecRef lambda) const override;
+
+    void computeImpulseDynamics(VecRef v_after, VecRef impulse, double restitution = 0.0) const override;
+    void computeImpulseDynamics(Workspace& ws, VecRef v_after, VecRef impulse, double restitution = 0.0) const override;
+
+    void computeForwardDynamicsDerivatives(MatRef dddq_dq,
+                                           MatRef dddq_dv,
+                                           MatRef dddq_dtau) const override;
+    void computeForwardDynamicsDerivatives(Workspace& ws,
+                                           MatRef dddq_dq,
+                                           MatRef dddq_dv,
+                                           MatRef dddq_dtau) const override;
+
+    Eigen::VectorXd getDynamicParameters() const override;
+
+    MatConstRef computeRegressor() const override;
+    MatConstRef computeRegressor(Workspace& ws) const override;
 
     void sum(VecConstRef q0, VecConstRef v, Eigen::VectorXd& q1) const override;
 
@@ -84,8 +180,35 @@ public:
 
 protected:
 
+    // replacement kernels for the queries on the model state, evaluated
+    // on a cache miss of the default workspace; caching and statistics
+    // stay with this class; they return false if not available, in which
+    // case the generic algorithm is used
+    virtual bool inverse_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef a,
+                                         VecRef tau) const;
+    virtual bool inertia_matrix_kernel(VecConstRef q, MatRef M) const;
+    virtual bool forward_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef tau,
+                                         VecRef ddq) const;
+
     JointParametrization get_joint_parametrization(string_const_ref jname) override;
 
+    // throws std::out_of_range if mat is not rows x cols
+    static void check_mat_size(MatConstRef mat, int rows, int cols, const char * func);
+
+    Workspace::UniquePtr create_workspace_impl() const override;
+
+    void update_workspace_impl(Workspace& ws) const override;
+
+    void init_batch_workers(int n_workers) const override;
+
+    void evaluate_batch_impl(MatConstRef Q,
+                             MatConstRef V,
+                             MatConstRef A,
+                             int sample_begin,
+                             int sample_end,
+                             int worker,
+                             BatchData& data) const override;
+
 private:
 
     pinocchio::Index get_frame_id(string_const_ref name) const;
@@ -95,30 +218,49 @@ private:
     pinocchio::Model _mdl_orig;
     pinocchio::Model _mdl;
     pinocchio::Model _mdl_zerograv;
-    mutable pinocchio::Data _data;
-    mutable pinocchio::Data _data_no_acc;
+
+    // single precision model, used for poses and jacobians
+    // if _float_kinematics is true
+    pinocchio::ModelTpl<float> _mdl_f;
+    bool _float_kinematics;
 
     mutable std::unordered_map<std::string, pinocchio::Index> _frame_idx;
 
     pinocchio::ReferenceFrame _world_aligned;
 
-    enum ComputationType
+    // note: kinematics levels are cumulative, i.e. KinematicsVelocity
+    // implies KinematicsPosition, and KinematicsAcceleration implies both
+    enum ComputationType : uint32_t
     {
         None = 0,
-        Kinematics = 1,
-        KinematicsNoAcc = 2,
-        Jacobians = 4,
-        Rnea = 8,
-        Gcomp = 16,
-        NonlinearEffects = 32,
-        Com = 64,
-        ComNoAcc = 128,
-        Crba = 256,
-        Minv = 512,
-        CCrba = 1024
+        KinematicsPosition = 1,
+        KinematicsVelocity = 2,
+        KinematicsAcceleration = 4,
+        KinematicsNoAcc = 8,
+        Jacobians = 16,
+        Rnea = 32,
+        Gcomp = 64,
+        NonlinearEffects = 128,
+        Com = 256,
+        ComNoAcc = 512,
+        Crba = 1024,
+        Minv = 2048,
+        CCrba = 4096,
+        JacobiansTimeVariation = 8192,
+        RneaDerivatives = 16384,
+        AbaDerivatives = 32768,
+        KinematicsDerivatives = 65536,
+        Cholesky = 131072,
+        ConstrainedDynamics = 262144,
+        Regressor = 524288,
+        KinematicsPositionFloat = 1048576,
+        JacobiansFloat = 2097152,
+        ComJacobian = 4194304,
+        ForwardDynamics = 8388608,
+        DCCrba = 16777216,
+        CentroidalDerivatives = 33554432
     };
 
-    mutable uint16_t _cached_computation;
 
     struct Temporaries
     {
@@ -129,12 +271,199 @@ private:
         Eigen::VectorXd gcomp;
         Eigen::VectorXd h;
 
+        // velocity derivatives (6 x nv)
+        Eigen::MatrixXd dv_dq;
+        Eigen::MatrixXd dv_dv;
+
+        // single precision kinematics
+        Eigen::VectorXf q_f;
+        Eigen::MatrixXf J_f;
+
+        // U^-1 * J^T, with M = U * D * U^T
+        Eigen::MatrixXd uinv_jt;
+
+        // constrained dynamics result, and effort it refers to
+        Eigen::VectorXd constrained_ddq;
+        Eigen::VectorXd constrained_lambda;
+        Eigen::VectorXd constrained_dynamics_tau;
+
+        // effort the cached aba derivatives refer to
+        Eigen::VectorXd aba_derivatives_tau;
+
+        // centroidal dynamics derivatives (6 x nv)
+        Eigen::MatrixXd dh_dq;
+        Eigen::MatrixXd dhdot_dq;
+        Eigen::MatrixXd dhdot_dv;
+        Eigen::MatrixXd dhdot_da;
+
+        // forward dynamics result, and effort it refers to
+        Eigen::VectorXd aba_ddq;
+        Eigen::VectorXd aba_tau;
+
         void resize(int nq, int nv);
     };
 
-    Eigen::MatrixXd _eye;
+    struct Statistics
+    {
+        uint64_t jacobian_single_frame = 0;
+        uint64_t jacobian_full_sweep = 0;
+        uint64_t jacobian_from_full_sweep = 0;
+        uint64_t kinematics_full_pass = 0;
+        uint64_t kinematics_incremental_pass = 0;
+        uint64_t kinematics_incremental_joints = 0;
+
+        // cache hits and misses, indexed by computation bit
+        std::array<uint64_t, 32> cache_hit = {};
+        std::array<uint64_t, 32> cache_miss = {};
+    };
+
+    // state a computation refers to (either the model's
+    // own state as of the last update(), or the state stored
+    // inside a workspace)
+    struct State
+    {
+        VecConstRef q, v, a, tau;
+    };
+
+    State model_state() const;
+
+    // pinocchio-specific workspace
+    struct WorkspacePin : Workspace
+    {
+        WorkspacePin(const ModelInterface2Pin& model);
+
+        const ModelInterface2Pin * owner;
+
+        pinocchio::Data data;
+        pinocchio::Data data_no_acc;
+        pinocchio::DataTpl<float> data_f;
+
+        uint32_t cached_computation;
+
+        // a frame placement inside data.oMf is valid if its
+        // stamp equals the current one
+        uint64_t stamp;
+        std::vector<uint64_t> frame_stamp;
+
+        // number of distinct frames whose jacobian was requested
+        // during the current and the previous cycle
+        std::vector<uint64_t> jac_stamp;
+        int n_jac_requests;
+        int n_jac_requests_prev;
+
+        Statistics stats;
+
+        Temporaries tmp;
+
+        // contact data, (re)initialized when the contact set changes
+        PINOCCHIO_STD_VECTOR_WITH_EIGEN_ALLOCATOR(pinocchio::RigidConstraintData) contact_data;
+        uint64_t contacts_version;
+
+        // state the kinematics stored inside data refers to, and
+        // level up to which it is valid (persists across cycles, and
+        // allows to only update the subtrees below changed joints)
+        Eigen::VectorXd kin_q, kin_v, kin_a;
+        uint32_t kin_level;
+        std::vector<char> kin_dirty;
 
-    mutable Temporaries _tmp;
+        // marks computations as invalid, including the stored kinematics
+        // (i.e. data was overwritten with values that do not refer
+        // to the recorded state)
+        void discard(uint32_t computation);
+
+        // data was overwritten with kinematics evaluated at the current
+        // state (e.g. by a dynamics algorithm): levels computed during
+        // this cycle are unaffected, the stored kinematics is lost otherwise
+        void overwrite(uint32_t computation);
+
+        State state() const;
+
+        void set_state(VecConstRef q, VecConstRef v, VecConstRef a);
+
+        void invalidate();
+
+        void reset_data(const pinocchio::Model& mdl);
+    };
+
+    WorkspacePin& workspace_cast(Workspace& ws) const;
+
+    // returns true if the given computation is cached inside ws (and the
+    // additional validity condition holds), and records a cache hit or miss
+    bool is_cached(WorkspacePin& ws, ComputationType c, bool valid = true) const;
+
+    // same as is_cached, for computations depending on the effort: this is
+    // not part of the recorded model state, so the result is only valid for
+    // the effort stored inside tau_slot, which is updated on a miss
+    bool is_cached_for_effort(WorkspacePin& ws, ComputationType c,
+                              const State& s, Eigen::VectorXd& tau_slot) const;
+
+    static const char * computation_name(int bit);
+
+    // lazy forward kinematics up to the requested level
+    void ensure_kinematics(WorkspacePin& ws, const State& s, uint32_t level) const;
+    void forward_kinematics_incremental(WorkspacePin& ws, const State& s, uint32_t level) const;
+    void record_kinematics(WorkspacePin& ws, const State& s, uint32_t level) const;
+    void ensure_frame_placement(WorkspacePin& ws, const State& s, int frame_idx) const;
+    void update_hot_frames(WorkspacePin& ws) const;
+
+    // jacobian requests are counted per cycle to choose between a
+    // single frame computation and a whole-tree sweep
+    void count_jacobian_request(WorkspacePin& ws, int frame_idx) const;
+    bool jacobian_full_sweep(const WorkspacePin& ws) const;
+
+    // implementations (shared by model-state and workspace versions)
+    Eigen::Affine3d get_pose(WorkspacePin& ws, const State& s, int frame_idx) const;
+    Eigen::Affine3d get_pose_f(WorkspacePin& ws, const State& s, int frame_idx) const;
+    void get_jacobian_f(WorkspacePin& ws, const State& s, int frame_idx,
+                        pinocchio::ReferenceFrame rf, MatRef J) const;
+    void get_jacobian(WorkspacePin& ws, const State& s, int frame_idx,
+                      pinocchio::ReferenceFrame rf, MatRef J) const;
+    Eigen::Vector6d get_velocity_twist(WorkspacePin& ws, const State& s, int frame_idx,
+                                       pinocchio::ReferenceFrame rf) const;
+    Eigen::Vector6d get_acceleration_twist(WorkspacePin& ws, const State& s, int frame_idx,
+                                           pinocchio::ReferenceFrame rf) const;
+    Eigen::Vector6d get_jdot_times_v(WorkspacePin& ws, const State& s, int frame_idx) const;
+    void get_jacobian_time_variation(WorkspacePin& ws, const State& s, int frame_idx, MatRef dJ) const;
+    void init_contact_data(WorkspacePin& ws) const;
+    void check_contact_output_size(VecConstRef x, VecConstRef lambda, const char * func) const;
+    void compute_constrained_dynamics(WorkspacePin& ws, const State& s,
+                                      VecRef ddq, VecRef lambda) const;
+    void compute_impulse_dynamics(WorkspacePin& ws, const State& s,
+                                  VecRef v_after, VecRef impulse, double restitution) const;
+    void ensure_kinematics_derivatives(WorkspacePin& ws, const State& s) const;
+    void get_velocity_twist_derivatives(WorkspacePin& ws, const State& s, int frame_idx,
+                                        MatRef dv_dq, MatRef dv_dv) const;
+    void get_acceleration_twist_derivatives(WorkspacePin& ws, const State& s, int frame_idx,
+                                            MatRef da_dq, MatRef da_dv, MatRef da_da) const;
+    void compute_com(WorkspacePin& ws, const State& s) const;
+    void get_com_jacobian(WorkspacePin& ws, const State& s, MatRef J) const;
+    Eigen::Vector3d get_com_jdot_times_v(WorkspacePin& ws, const State& s) const;
+    VecConstRef compute_inverse_dynamics(WorkspacePin& ws, const State& s) const;
+    VecConstRef compute_gravity_compensation(WorkspacePin& ws, const State& s) const;
+    VecConstRef compute_nonlinear_term(WorkspacePin& ws, const State& s) const;
+    VecConstRef compute_forward_dynamics(WorkspacePin& ws, const State& s) const;
+    MatConstRef compute_inertia_matrix(WorkspacePin& ws, const State& s) const;
+    MatConstRef compute_inertia_inverse(WorkspacePin& ws, const State& s) const;
+    void compute_cholesky(WorkspacePin& ws, const State& s) const;
+    void compute_inertia_inverse_times(WorkspacePin& ws, const State& s,
+                                       MatConstRef B, MatRef MinvB) const;
+    void compute_inverse_operational_space_inertia(WorkspacePin& ws, const State& s,
+                                                   MatConstRef J, MatRef Linv) const;
+    MatConstRef compute_centroidal_momentum_matrix(WorkspacePin& ws, const State& s) const;
+    MatConstRef compute_centroidal_momentum_matrix_time_variation(WorkspacePin& ws, const State& s) const;
+    void compute_centroidal_dynamics_derivatives(WorkspacePin& ws, const State& s,
+                                                 MatRef dh_dq, MatRef dhdot_dq,
+                                                 MatRef dhdot_dv, MatRef dhdot_da) const;
+    MatConstRef compute_regressor(WorkspacePin& ws, const State& s) const;
+    void compute_inverse_dynamics_derivatives(WorkspacePin& ws, const State& s,
+                                              MatRef dtau_dq, MatRef dtau_dv, MatRef dtau_da) const;
+    void compute_forward_dynamics_derivatives(WorkspacePin& ws, const State& s,
+                                              MatRef dddq_dq, MatRef dddq_dv, MatRef dddq_dtau) const;
+
+    // default workspace, used by queries on the model state
+    mutable std::unique_ptr<WorkspacePin> _ws;
+
+    Eigen::MatrixXd _eye;
 
     Eigen::VectorXd _qneutral;
 
@@ -149,6 +478,28 @@ private:
 
     std::unordered_map<int, AttachedBody> _attached_body_map;
 
+    // frames whose placement is updated with forward kinematics
+    std::vector<pinocchio::FrameIndex> _hot_frames;
+
+    // number of distinct jacobians per cycle above which the whole
+    // tree is swept by computeJointJacobians
+    int _jac_full_sweep_threshold;
+
+    // registered contacts
+    PINOCCHIO_STD_VECTOR_WITH_EIGEN_ALLOCATOR(pinocchio::RigidConstraintModel) _contact_models;
+    int _contact_dim;
+    uint64_t _contacts_version;
+
+    // total mass, recomputed by update_impl() when attached bodies change
+    double _mass;
+    bool _inertia_changed;
+
+    // only update the subtrees whose joint state changed
+    bool _incremental_kinematics;
+
+    // one workspace per batch worker
+    mutable std::vector<std::unique_ptr<WorkspacePin>> _batch_ws;
+
 
 };
 
@@ -1,29 +1,128 @@
 #include "modelinterface2_pin.h"
 
 #include <pinocchio/algorithm/aba.hpp>
+#include <pinocchio/algorithm/aba-derivatives.hpp>
 
 using namespace XBot;
 
 VecConstRef ModelInterface2Pin::computeForwardDynamics() const
 {
-    return pinocchio::aba(_mdl, _data,
-                          getJointPosition(),
-                          getJointVelocity(),
-                          getJointEffort());
+    return compute_forward_dynamics(*_ws, model_state());
+}
+
+VecConstRef ModelInterface2Pin::computeForwardDynamics(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_forward_dynamics(pws, pws.state());
+}
+
+VecConstRef ModelInterface2Pin::compute_forward_dynamics(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached_for_effort(ws, ForwardDynamics, s, ws.tmp.aba_tau))
+    {
+        if(&ws != _ws.get() ||
+            !forward_dynamics_kernel(s.q, s.v, s.tau, ws.tmp.aba_ddq))
+        {
+            pinocchio::aba(_mdl, ws.data,
+                           s.q,
+                           s.v,
+                           s.tau);
+
+            // data.ddq is also written by other algorithms, keep a copy
+            ws.tmp.aba_ddq = ws.data.ddq;
+
+            // aba overwrites the spatial accelerations stored inside data
+            ws.overwrite(KinematicsPosition | KinematicsVelocity);
+            ws.discard(KinematicsAcceleration | KinematicsDerivatives);
+        }
+
+        ws.cached_computation |= ForwardDynamics;
+    }
+
+    return ws.tmp.aba_ddq;
+}
+
+bool ModelInterface2Pin::forward_dynamics_kernel(VecConstRef, VecConstRef, VecConstRef,
+                                                 VecRef) const
+{
+    return false;
+}
+
+void ModelInterface2Pin::computeForwardDynamicsDerivatives(MatRef dddq_dq,
+                                                           MatRef dddq_dv,
+                                                           MatRef dddq_dtau) const
+{
+    compute_forward_dynamics_derivatives(*_ws, model_state(), dddq_dq, dddq_dv, dddq_dtau);
+}
+
+void ModelInterface2Pin::computeForwardDynamicsDerivatives(Workspace& ws,
+                                                           MatRef dddq_dq,
+                                                           MatRef dddq_dv,
+                                                           MatRef dddq_dtau) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_forward_dynamics_derivatives(pws, pws.state(), dddq_dq, dddq_dv, dddq_dtau);
+}
+
+void ModelInterface2Pin::compute_forward_dynamics_derivatives(WorkspacePin& ws,
+                                                              const State& s,
+                                                              MatRef dddq_dq,
+                                                              MatRef dddq_dv,
+                                                              MatRef dddq_dtau) const
+{
+    if(!is_cached_for_effort(ws, AbaDerivatives, s, ws.tmp.aba_derivatives_tau))
+    {
+        // note: results are stored inside data.ddq_dq, data.ddq_dv,
+        // and (upper triangular part only) data.Minv
+        pinocchio::computeABADerivatives(_mdl, ws.data,
+                                         s.q,
+                                         s.v,
+                                         s.tau);
+
+        // data.Minv is the inverse inertia at the current q, share it
+        // with computeMinverse
+        ws.data.Minv.triangularView<Eigen::StrictlyLower>() =
+            ws.data.Minv.transpose().triangularView<Eigen::StrictlyLower>();
+
+        // aba overwrites the spatial accelerations stored inside data,
+        // the kinematics derivatives, and data.dtau_dq / data.dtau_dv
+        // (evaluated at its own ddq)
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration | KinematicsDerivatives | RneaDerivatives);
+
+        ws.cached_computation |= AbaDerivatives | Minv;
+    }
+
+    dddq_dq = ws.data.ddq_dq;
+    dddq_dv = ws.data.ddq_dv;
+    dddq_dtau = ws.data.Minv;
 }
 
 MatConstRef ModelInterface2Pin::computeInertiaInverse() const
 {
-    if(!(_cached_computation & Minv))
+    return compute_inertia_inverse(*_ws, model_state());
+}
+
+MatConstRef ModelInterface2Pin::computeInertiaInverse(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_inertia_inverse(pws, pws.state());
+}
+
+MatConstRef ModelInterface2Pin::compute_inertia_inverse(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Minv))
     {
-        pinocchio::computeMinverse(_mdl, _data, getJointPosition());
+        pinocchio::computeMinverse(_mdl, ws.data, s.q);
+
+        ws.overwrite(KinematicsPosition);
 
-        _data.Minv.triangularView<Eigen::StrictlyLower>() =
-            _data.Minv.transpose().triangularView<Eigen::StrictlyLower>();
+        ws.data.Minv.triangularView<Eigen::StrictlyLower>() =
+            ws.data.Minv.transpose().triangularView<Eigen::StrictlyLower>();
 
 
-        _cached_computation |= Minv;
+        ws.cached_computation |= Minv;
     }
 
-    return Eigen::Map<Eigen::MatrixXd>(_data.Minv.data(), _mdl.nv, _mdl.nv);
+    return Eigen::Map<Eigen::MatrixXd>(ws.data.Minv.data(), _mdl.nv, _mdl.nv);
 }
@@ -0,0 +1,109 @@
+#include "modelinterface2_pin.h"
+
+#include <pinocchio/algorithm/crba.hpp>
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+#include <pinocchio/algorithm/regressor.hpp>
+#include <pinocchio/algorithm/rnea.hpp>
+
+using namespace XBot;
+
+void ModelInterface2Pin::init_batch_workers(int n_workers) const
+{
+    while(int(_batch_ws.size()) < n_workers)
+    {
+        _batch_ws.push_back(std::make_unique<WorkspacePin>(*this));
+    }
+
+    // data must be re-created if frames were added
+    for(auto& ws : _batch_ws)
+    {
+        if(int(ws->data.oMf.size()) != _mdl.nframes)
+        {
+            ws->reset_data(_mdl);
+        }
+    }
+}
+
+void ModelInterface2Pin::evaluate_batch_impl(MatConstRef Q,
+                                             MatConstRef V,
+                                             MatConstRef A,
+                                             int sample_begin,
+                                             int sample_end,
+                                             int worker,
+                                             BatchData& bd) const
+{
+    auto& data = _batch_ws.at(worker)->data;
+
+    const int nv = _mdl.nv;
+    const int nlinks = bd.link_ids.size();
+
+    for(int id : bd.link_ids)
+    {
+        check_frame_idx_throw(id);
+    }
+
+    for(int i = sample_begin; i < sample_end; i++)
+    {
+        auto q = Q.col(i);
+
+        // kinematics
+        if(bd.computation & BatchData::Jacobians)
+        {
+            // note: includes forward kinematics
+            pinocchio::computeJointJacobians(_mdl, data, q);
+        }
+        else if(bd.computation & BatchData::Poses)
+        {
+            pinocchio::forwardKinematics(_mdl, data, q);
+        }
+
+        for(int k = 0; k < nlinks; k++)
+        {
+            if(!(bd.computation & (BatchData::Poses | BatchData::Jacobians)))
+            {
+                break;
+            }
+
+            int frame_idx = bd.link_ids[k];
+
+            const auto& oMf = pinocchio::updateFramePlacement(_mdl, data, frame_idx);
+
+            if(bd.computation & BatchData::Poses)
+            {
+                auto& T = bd.poses[i*nlinks + k];
+                T.translation() = oMf.translation();
+                T.linear() = oMf.rotation();
+            }
+
+            if(bd.computation & BatchData::Jacobians)
+            {
+                auto J = bd.jacobians.block(6*k, nv*i, 6, nv);
+                J.setZero();
+                pinocchio::getFrameJacobian(_mdl, data, frame_idx, _world_aligned, J);
+            }
+        }
+
+        // dynamics
+        if(bd.computation & BatchData::GravityCompensation)
+        {
+            bd.gcomp.col(i) = pinocchio::computeGeneralizedGravity(_mdl, data, q);
+        }
+
+        if(bd.computation & BatchData::InertiaMatrix)
+        {
+            pinocchio::crba(_mdl, data, q);
+
+            data.M.triangularView<Eigen::StrictlyLower>() =
+                data.M.transpose().triangularView<Eigen::StrictlyLower>();
+
+            bd.inertia.middleCols(nv*i, nv) = data.M;
+        }
+
+        if(bd.computation & BatchData::Regressor)
+        {
+            bd.regressor.middleRows(nv*i, nv) =
+                pinocchio::computeJointTorqueRegressor(_mdl, data, q, V.col(i), A.col(i));
+        }
+    }
+}
@@ -1,27 +1,120 @@
 #include "modelinterface2_pin.h"
 
 #include <pinocchio/algorithm/centroidal.hpp>
+#include <pinocchio/algorithm/centroidal-derivatives.hpp>
 
 using namespace XBot;
 
 MatConstRef ModelInterface2Pin::computeCentroidalMomentumMatrix() const
 {
-    if(!(_cached_computation & CCrba))
+    return compute_centroidal_momentum_matrix(*_ws, model_state());
+}
+
+MatConstRef ModelInterface2Pin::computeCentroidalMomentumMatrix(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_centroidal_momentum_matrix(pws, pws.state());
+}
+
+MatConstRef ModelInterface2Pin::compute_centroidal_momentum_matrix(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, CCrba))
     {
-        pinocchio::ccrba(_mdl, _data, getJointPosition(), getJointVelocity());
+        pinocchio::ccrba(_mdl, ws.data, s.q, s.v);
+
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
 
-        _cached_computation |= CCrba;
+        ws.cached_computation |= CCrba;
     }
 
-    return _data.Ag;
+    return ws.data.Ag;
 }
 
 Eigen::Vector6d ModelInterface2Pin::computeCentroidalMomentum() const
 {
-    if(!(_cached_computation & CCrba))
+    if(!(_ws->cached_computation & CCrba))
     {
-        return pinocchio::computeCentroidalMomentum(_mdl, _data);
+        ensure_kinematics(*_ws, model_state(), KinematicsVelocity);
+
+        return pinocchio::computeCentroidalMomentum(_mdl, _ws->data);
+    }
+
+    return _ws->data.hg;
+}
+
+MatConstRef ModelInterface2Pin::computeCentroidalMomentumMatrixTimeVariation() const
+{
+    return compute_centroidal_momentum_matrix_time_variation(*_ws, model_state());
+}
+
+MatConstRef ModelInterface2Pin::computeCentroidalMomentumMatrixTimeVariation(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_centroidal_momentum_matrix_time_variation(pws, pws.state());
+}
+
+MatConstRef ModelInterface2Pin::compute_centroidal_momentum_matrix_time_variation(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, DCCrba))
+    {
+        // note: also computes data.Ag and data.hg
+        pinocchio::dccrba(_mdl, ws.data, s.q, s.v);
+
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+
+        ws.cached_computation |= DCCrba | CCrba;
+    }
+
+    return ws.data.dAg;
+}
+
+void ModelInterface2Pin::computeCentroidalDynamicsDerivatives(MatRef dh_dq,
+                                                              MatRef dhdot_dq,
+                                                              MatRef dhdot_dv,
+                                                              MatRef dhdot_da) const
+{
+    compute_centroidal_dynamics_derivatives(*_ws, model_state(), dh_dq, dhdot_dq, dhdot_dv, dhdot_da);
+}
+
+void ModelInterface2Pin::computeCentroidalDynamicsDerivatives(Workspace& ws,
+                                                              MatRef dh_dq,
+                                                              MatRef dhdot_dq,
+                                                              MatRef dhdot_dv,
+                                                              MatRef dhdot_da) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_centroidal_dynamics_derivatives(pws, pws.state(), dh_dq, dhdot_dq, dhdot_dv, dhdot_da);
+}
+
+void ModelInterface2Pin::compute_centroidal_dynamics_derivatives(WorkspacePin& ws,
+                                                                 const State& s,
+                                                                 MatRef dh_dq,
+                                                                 MatRef dhdot_dq,
+                                                                 MatRef dhdot_dv,
+                                                                 MatRef dhdot_da) const
+{
+    if(!is_cached(ws, CentroidalDerivatives))
+    {
+        pinocchio::computeCentroidalDynamicsDerivatives(_mdl, ws.data,
+                                                        s.q,
+                                                        s.v,
+                                                        s.a,
+                                                        ws.tmp.dh_dq,
+                                                        ws.tmp.dhdot_dq,
+                                                        ws.tmp.dhdot_dv,
+                                                        ws.tmp.dhdot_da);
+
+        // note: data.dVdq, data.dAdq, data.dAdv are overwritten
+        ws.cached_computation &= ~KinematicsDerivatives;
+
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration);
+
+        ws.cached_computation |= CentroidalDerivatives;
     }
 
-    return _data.hg;
+    dh_dq = ws.tmp.dh_dq;
+    dhdot_dq = ws.tmp.dhdot_dq;
+    dhdot_dv = ws.tmp.dhdot_dv;
+    dhdot_da = ws.tmp.dhdot_da;
 }
@@ -0,0 +1,293 @@
+#include "modelinterface2_pin_cg.h"
+
+#include <pinocchio/config.hpp>
+
+#include <xbot2_interface/common/plugin.h>
+#include <xbot2_interface/logger.h>
+
+using namespace XBot;
+
+namespace {
+
+// 64-bit FNV-1a, stable across runs and standard library implementations
+uint64_t fnv1a_hash(const std::string& str)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for(unsigned char c : str)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+}
+
+ModelInterface2PinCg::ModelInterface2PinCg(const ConfigOptions& opt):
+    ModelInterface2Pin(opt),
+    _cg_enabled(true),
+    _cg_frames_hit(0),
+    _cg_frames_miss(0)
+{
+    pinocchio::urdf::buildModel(std::const_pointer_cast<urdf::Model>(getUrdf()), _cg_mdl);
+
+    _cg_prefix = get_library_prefix(opt);
+
+    _cg_rnea = std::make_unique<CodeGenCached<pinocchio::CodeGenRNEA<double>>>(
+        _cg_mdl, "rnea", _cg_prefix + "_rnea");
+
+    _cg_crba = std::make_unique<CodeGenCached<pinocchio::CodeGenCRBA<double>>>(
+        _cg_mdl, "crba", _cg_prefix + "_crba");
+
+    _cg_aba = std::make_unique<CodeGenCached<pinocchio::CodeGenABA<double>>>(
+        _cg_mdl, "aba", _cg_prefix + "_aba");
+
+    // generate and compile the libraries unless cached
+    // from a previous run on the same urdf
+    _cg_rnea->loadOrGenerateLib();
+    _cg_crba->loadOrGenerateLib();
+    _cg_aba->loadOrGenerateLib();
+
+    _q = getJointPosition();
+}
+
+std::string ModelInterface2PinCg::get_library_prefix(const ConfigOptions& opt) const
+{
+    // note: generated libraries are dlopen'ed, so that the default
+    // cache is private to the current user
+    std::string cache_dir;
+
+    if(const char * xdg_dir = getenv("XDG_CACHE_HOME"); xdg_dir && *xdg_dir)
+    {
+        cache_dir = std::string(xdg_dir) + "/xbot2ifc_codegen";
+    }
+    else if(const char * home_dir = getenv("HOME"); home_dir && *home_dir)
+    {
+        cache_dir = std::string(home_dir) + "/.cache/xbot2ifc_codegen";
+    }
+
+    if(const char * env_dir = getenv("XBOT2IFC_CODEGEN_CACHE"))
+    {
+        cache_dir = env_dir;
+    }
+
+    opt.get_parameter("codegen_cache_dir", cache_dir);
+
+    if(cache_dir.empty())
+    {
+        throw std::runtime_error("could not determine the codegen cache directory: "
+                                 "set XBOT2IFC_CODEGEN_CACHE or the codegen_cache_dir parameter");
+    }
+
+    if(std::filesystem::create_directories(cache_dir))
+    {
+        std::filesystem::permissions(cache_dir, std::filesystem::perms::owner_all,
+                                     std::filesystem::perm_options::replace);
+    }
+
+    if(!is_trusted_path(cache_dir))
+    {
+        throw std::runtime_error("codegen cache directory '" + cache_dir + "' must be owned "
+                                 "by the current user, and not writable by others");
+    }
+
+    // libraries are keyed by the urdf they were generated for, and by
+    // the pinocchio and compiler versions they were generated with
+    std::string key = getUrdfString();
+
+    key += std::to_string(PINOCCHIO_MAJOR_VERSION) + "." +
+           std::to_string(PINOCCHIO_MINOR_VERSION) + "." +
+           std::to_string(PINOCCHIO_PATCH_VERSION);
+
+    key += __VERSION__;
+
+    auto key_hash = fnv1a_hash(key);
+
+    return cache_dir + "/" + getName() + "_" + std::to_string(key_hash);
+}
+
+ModelInterface::UniquePtr ModelInterface2PinCg::clone() const
+{
+    return std::make_unique<ModelInterface2PinCg>(getConfigOptions());
+}
+
+void ModelInterface2PinCg::update_impl()
+{
+    ModelInterface2Pin::update_impl();
+
+    _q = getJointPosition();
+
+    for(auto& [unused, fk] : _cg_frames)
+    {
+        fk.evaluated = false;
+    }
+}
+
+void ModelInterface2PinCg::setHotLinks(const std::vector<int>& link_ids)
+{
+    ModelInterface2Pin::setHotLinks(link_ids);
+
+    if(!_cg_enabled)
+    {
+        return;
+    }
+
+    // generate kinematics code for newly added hot links
+    for(int id : link_ids)
+    {
+        if(_cg_frames.contains(id))
+        {
+            continue;
+        }
+
+        auto cg = std::make_unique<CodeGenCached<CodeGenFrameKinematics<double>>>(
+            _cg_mdl, id, "frame_kinematics", _cg_prefix + "_frame_" + std::to_string(id));
+
+        cg->loadOrGenerateLib();
+
+        _cg_frames[id].cg = std::move(cg);
+    }
+}
+
+CodeGenFrameKinematics<double> * ModelInterface2PinCg::get_frame_kinematics(int link_id) const
+{
+    if(!_cg_enabled)
+    {
+        return nullptr;
+    }
+
+    auto it = _cg_frames.find(link_id);
+
+    if(it == _cg_frames.end())
+    {
+        return nullptr;
+    }
+
+    auto& fk = it->second;
+
+    if(fk.evaluated)
+    {
+        _cg_frames_hit++;
+        return fk.cg.get();
+    }
+
+    _cg_frames_miss++;
+
+    fk.cg->evalFunction(_q);
+    fk.evaluated = true;
+
+    return fk.cg.get();
+}
+
+Eigen::Affine3d ModelInterface2PinCg::getPose(int link_id) const
+{
+    if(auto fk = get_frame_kinematics(link_id))
+    {
+        return fk->pose;
+    }
+
+    return ModelInterface2Pin::getPose(link_id);
+}
+
+void ModelInterface2PinCg::getJacobian(int link_id, MatRef J) const
+{
+    check_mat_size(J, 6, getNv(), __func__);
+
+    if(auto fk = get_frame_kinematics(link_id))
+    {
+        J = fk->J;
+        return;
+    }
+
+    ModelInterface2Pin::getJacobian(link_id, J);
+}
+
+bool ModelInterface2PinCg::inverse_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef a,
+                                                   VecRef tau) const
+{
+    if(!_cg_enabled)
+    {
+        return false;
+    }
+
+    _cg_rnea->evalFunction(q, v, a);
+
+    tau = _cg_rnea->res;
+
+    return true;
+}
+
+bool ModelInterface2PinCg::inertia_matrix_kernel(VecConstRef q, MatRef M) const
+{
+    if(!_cg_enabled)
+    {
+        return false;
+    }
+
+    // note: the generated code fills the whole (symmetric) matrix
+    _cg_crba->evalFunction(q);
+
+    M = _cg_crba->M;
+
+    return true;
+}
+
+bool ModelInterface2PinCg::forward_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef tau,
+                                                   VecRef ddq) const
+{
+    if(!_cg_enabled)
+    {
+        return false;
+    }
+
+    _cg_aba->evalFunction(q, v, tau);
+
+    ddq = _cg_aba->ddq;
+
+    return true;
+}
+
+int ModelInterface2PinCg::addFixedLink(string_const_ref link_name,
+                                       string_const_ref parent_name,
+                                       double mass,
+                                       Eigen::Matrix3d inertia,
+                                       Eigen::Affine3d pose)
+{
+    if(_cg_enabled)
+    {
+        Logger::warning("%s: model was modified, "
+                        "falling back to non-generated code \n", __func__);
+    }
+
+    _cg_enabled = false;
+
+    return ModelInterface2Pin::addFixedLink(link_name, parent_name, mass, inertia, pose);
+}
+
+bool ModelInterface2PinCg::isCodegenEnabled() const
+{
+    return _cg_enabled;
+}
+
+std::map<std::string, uint64_t> ModelInterface2PinCg::getComputationStatistics() const
+{
+    auto ret = ModelInterface2Pin::getComputationStatistics();
+
+    ret["codegen_enabled"] = _cg_enabled;
+    ret["codegen_kinematics_hit"] = _cg_frames_hit;
+    ret["codegen_kinematics_miss"] = _cg_frames_miss;
+
+    return ret;
+}
+
+void ModelInterface2PinCg::resetComputationStatistics()
+{
+    ModelInterface2Pin::resetComputationStatistics();
+
+    _cg_frames_hit = 0;
+    _cg_frames_miss = 0;
+}
+
+XBOT2_REGISTER_MODEL_PLUGIN(ModelInterface2PinCg, pin_cg);
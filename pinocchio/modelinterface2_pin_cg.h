@@ -0,0 +1,335 @@
+#ifndef MODELINTERFACE2_PIN_CG_H
+#define MODELINTERFACE2_PIN_CG_H
+
+// note: must be included before any other pinocchio header
+#include <pinocchio/codegen/cppadcg.hpp>
+#include <pinocchio/codegen/code-generator-algo.hpp>
+
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+#include <pinocchio/algorithm/kinematics.hpp>
+
+#include <filesystem>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "modelinterface2_pin.h"
+
+namespace XBot {
+
+/**
+ * @brief is_trusted_path returns true if the given file or directory
+ * exists, is owned by the current user, and is not writable by others
+ * (i.e. nobody else could have planted a library there)
+ */
+inline bool is_trusted_path(const std::string& path)
+{
+    struct stat st;
+
+    if(stat(path.c_str(), &st) != 0)
+    {
+        return false;
+    }
+
+    return st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/**
+ * @brief CodeGenFrameKinematics generates code for the placement and the
+ * (local world aligned) jacobian of a single frame, i.e. the quantities
+ * returned by getPose() and getJacobian(); the recorded function chains
+ * forwardKinematics, updateFramePlacement and computeFrameJacobian
+ */
+template <typename _Scalar>
+struct CodeGenFrameKinematics : pinocchio::CodeGenBase<_Scalar>
+{
+    typedef pinocchio::CodeGenBase<_Scalar> Base;
+    typedef typename Base::Scalar Scalar;
+    typedef typename Base::Model Model;
+    typedef typename Base::MatrixXs MatrixXs;
+    typedef typename Base::ADModel::ConfigVectorType ADConfigVectorType;
+    typedef typename Base::ADData::Matrix6x ADMatrix6x;
+
+    CodeGenFrameKinematics(const Model& model,
+                           pinocchio::FrameIndex frame_id,
+                           const std::string& function_name,
+                           const std::string& library_name):
+        Base(model, model.nq, 12 + 6*model.nv, function_name, library_name),
+        frame_id(frame_id)
+    {
+        pose.setIdentity();
+        J.setZero(6, model.nv);
+    }
+
+    void buildMap() override
+    {
+        CppAD::Independent(ad_X);
+
+        ADConfigVectorType ad_q = ad_X.head(ad_model.nq);
+
+        pinocchio::forwardKinematics(ad_model, ad_data, ad_q);
+
+        pinocchio::updateFramePlacement(ad_model, ad_data, frame_id);
+
+        ADMatrix6x ad_J = ADMatrix6x::Zero(6, ad_model.nv);
+
+        pinocchio::computeFrameJacobian(ad_model, ad_data, ad_q, frame_id,
+                                        pinocchio::LOCAL_WORLD_ALIGNED, ad_J);
+
+        // output = [translation; vec(rotation); vec(J)]
+        const auto& oMf = ad_data.oMf[frame_id];
+
+        ad_Y.template head<3>() = oMf.translation();
+
+        for(int j = 0; j < 3; j++)
+        {
+            ad_Y.template segment<3>(3 + 3*j) = oMf.rotation().col(j);
+        }
+
+        for(int j = 0; j < ad_model.nv; j++)
+        {
+            ad_Y.template segment<6>(12 + 6*j) = ad_J.col(j);
+        }
+
+        ad_fun.Dependent(ad_X, ad_Y);
+        ad_fun.optimize("no_compare_op");
+    }
+
+    using Base::evalFunction;
+
+    template <typename ConfigVectorType>
+    void evalFunction(const Eigen::MatrixBase<ConfigVectorType>& q)
+    {
+        Base::evalFunction(q);
+
+        pose.translation() = y.template head<3>();
+        pose.linear() = Eigen::Map<const Eigen::Matrix<Scalar, 3, 3>>(y.data() + 3);
+        J = Eigen::Map<const MatrixXs>(y.data() + 12, 6, ad_model.nv);
+    }
+
+    Eigen::Transform<Scalar, 3, Eigen::Affine> pose;
+    MatrixXs J;
+
+protected:
+
+    using Base::ad_model;
+    using Base::ad_data;
+    using Base::ad_fun;
+    using Base::ad_X;
+    using Base::ad_Y;
+    using Base::y;
+
+    pinocchio::FrameIndex frame_id;
+};
+
+/**
+ * @brief CodeGenCached loads the library of a pinocchio code generator
+ * from disk if it was generated by a previous run, and otherwise
+ * records the function, and generates and compiles the library
+ *
+ * @note pinocchio's existLib() and loadLib() require the library
+ * processor created by initLib(), i.e. the (expensive) recording of
+ * the function, hence the cached library is looked up and loaded here
+ *
+ * @note the library is compiled under a process-specific name and then
+ * renamed into place, so that a crashed build or concurrent processes
+ * never leave a partially written library behind; a cached library
+ * that fails to load, or that is not owned by the current user,
+ * is regenerated
+ */
+template <typename CodeGen>
+struct CodeGenCached : CodeGen
+{
+    using CodeGen::CodeGen;
+
+    typedef typename CodeGen::Scalar Scalar;
+
+    void loadOrGenerateLib(const std::string& gcc_path = "/usr/bin/gcc")
+    {
+        std::string lib_file = this->library_name +
+                               CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION;
+
+        if(is_trusted_path(lib_file) && tryLoadLib(lib_file))
+        {
+            return;
+        }
+
+        this->initLib();
+
+        compileLibAndRename(lib_file, gcc_path);
+
+        if(!tryLoadLib(lib_file))
+        {
+            throw std::runtime_error("could not load generated library '" + lib_file + "'");
+        }
+    }
+
+private:
+
+    bool tryLoadLib(const std::string& lib_file)
+    {
+        // note: the model must be released before its library
+        this->generatedFun_ptr.reset();
+        this->dynamicLib_ptr.reset();
+
+        try
+        {
+            this->dynamicLib_ptr.reset(new CppAD::cg::LinuxDynamicLib<Scalar>(lib_file));
+            this->generatedFun_ptr = this->dynamicLib_ptr->model(this->function_name.c_str());
+        }
+        catch(std::exception&)
+        {
+            this->generatedFun_ptr.reset();
+            this->dynamicLib_ptr.reset();
+            return false;
+        }
+
+        if(!this->generatedFun_ptr)
+        {
+            this->dynamicLib_ptr.reset();
+            return false;
+        }
+
+        return true;
+    }
+
+    void compileLibAndRename(const std::string& lib_file, const std::string& gcc_path)
+    {
+        // same settings as pinocchio's compileLib()
+        std::string tmp_name = this->library_name + ".tmp" + std::to_string(getpid());
+
+        CppAD::cg::GccCompiler<Scalar> compiler(gcc_path);
+        std::vector<std::string> compile_options = compiler.getCompileFlags();
+        compile_options[0] = "-Ofast";
+        compiler.setCompileFlags(compile_options);
+        compiler.setTemporaryFolder(tmp_name + "_build");
+
+        CppAD::cg::DynamicModelLibraryProcessor<Scalar> processor(*this->libcgen_ptr, tmp_name);
+
+        processor.createDynamicLibrary(compiler, false);
+
+        std::filesystem::remove_all(tmp_name + "_build");
+
+        std::string tmp_file = tmp_name + CppAD::cg::system::SystemInfo<>::DYNAMIC_LIB_EXTENSION;
+
+        // not writable by others regardless of the umask, see is_trusted_path()
+        std::filesystem::permissions(tmp_file, std::filesystem::perms::owner_all,
+                                     std::filesystem::perm_options::replace);
+
+        std::filesystem::rename(tmp_file, lib_file);
+    }
+};
+
+/**
+ * @brief ModelInterface2PinCg extends the pinocchio backend by
+ * dispatching inverse dynamics, inertia matrix and forward dynamics
+ * queries on the model state, as well as poses and jacobians of the
+ * hot links (see setHotLinks()), to straight-line code that is generated
+ * (via CppADCodeGen) for the given urdf, compiled into a shared object,
+ * and cached on disk for subsequent loads
+ *
+ * @note generated dynamics replace the generic algorithms on a cache
+ * miss of the model-state queries, i.e. results are cached (and counted
+ * by getComputationStatistics()) as for the pinocchio backend; the
+ * overloads taking a workspace (and hence evaluateBatch()) run the
+ * generic pinocchio algorithms
+ *
+ * @note the kinematics code for a hot link is generated by setHotLinks(),
+ * unless cached on disk; it evaluates both the pose and the jacobian,
+ * at most once per update()
+ *
+ * @note the generated code is only valid for the model it was generated
+ * from; after addFixedLink() all queries fall back to the generic
+ * algorithms, see isCodegenEnabled()
+ */
+class ModelInterface2PinCg : public ModelInterface2Pin
+{
+
+public:
+
+    ModelInterface2PinCg(const ConfigOptions& opt);
+
+    UniquePtr clone() const override;
+
+    void update_impl() override;
+
+    using ModelInterface2Pin::setHotLinks;
+    void setHotLinks(const std::vector<int>& link_ids) override;
+
+    using ModelInterface2Pin::getPose;
+    Eigen::Affine3d getPose(int link_id) const override;
+
+    using ModelInterface2Pin::getJacobian;
+    void getJacobian(int link_id, MatRef J) const override;
+
+    int addFixedLink(string_const_ref link_name,
+                     string_const_ref parent_name,
+                     double mass,
+                     Eigen::Matrix3d inertia,
+                     Eigen::Affine3d pose) override;
+
+    /**
+     * @brief isCodegenEnabled returns false if the model was modified
+     * after construction, i.e. generated code is no longer used
+     */
+    bool isCodegenEnabled() const;
+
+    /**
+     * @brief getComputationStatistics extends the pinocchio counters
+     * with the "codegen_enabled" entry, and with the hits and misses
+     * of the generated hot link kinematics ("codegen_kinematics_hit",
+     * "codegen_kinematics_miss")
+     */
+    std::map<std::string, uint64_t> getComputationStatistics() const override;
+
+    void resetComputationStatistics() override;
+
+protected:
+
+    bool inverse_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef a,
+                                 VecRef tau) const override;
+
+    bool inertia_matrix_kernel(VecConstRef q, MatRef M) const override;
+
+    bool forward_dynamics_kernel(VecConstRef q, VecConstRef v, VecConstRef tau,
+                                 VecRef ddq) const override;
+
+private:
+
+    std::string get_library_prefix(const ConfigOptions& opt) const;
+
+    // evaluates the kinematics of a hot link at most once per update(),
+    // returns nullptr if no generated code is available
+    CodeGenFrameKinematics<double> * get_frame_kinematics(int link_id) const;
+
+    // generated code is only valid for the original model
+    bool _cg_enabled;
+
+    // model the code is generated from, and library prefix
+    pinocchio::Model _cg_mdl;
+    std::string _cg_prefix;
+
+    mutable std::unique_ptr<CodeGenCached<pinocchio::CodeGenRNEA<double>>> _cg_rnea;
+    mutable std::unique_ptr<CodeGenCached<pinocchio::CodeGenCRBA<double>>> _cg_crba;
+    mutable std::unique_ptr<CodeGenCached<pinocchio::CodeGenABA<double>>> _cg_aba;
+
+    struct FrameKinematics
+    {
+        std::unique_ptr<CodeGenCached<CodeGenFrameKinematics<double>>> cg;
+        bool evaluated = false;
+    };
+
+    mutable std::unordered_map<int, FrameKinematics> _cg_frames;
+
+    // joint position as of the last update()
+    Eigen::VectorXd _q;
+
+    mutable uint64_t _cg_frames_hit;
+    mutable uint64_t _cg_frames_miss;
+
+};
+
+}
+
+#endif // MODELINTERFACE2_PIN_CG_H
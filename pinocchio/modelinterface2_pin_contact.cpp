@@ -0,0 +1,168 @@
+#include "modelinterface2_pin.h"
+
+#include <pinocchio/algorithm/constrained-dynamics.hpp>
+#include <pinocchio/algorithm/impulse-dynamics.hpp>
+
+using namespace XBot;
+
+void ModelInterface2Pin::setContacts(const std::vector<int>& link_ids,
+                                     const std::vector<ContactType>& types)
+{
+    if(link_ids.size() != types.size())
+    {
+        throw std::invalid_argument("link_ids.size() != types.size() (" +
+                                    std::to_string(link_ids.size()) + " != " +
+                                    std::to_string(types.size()) + ")");
+    }
+
+    for(int id : link_ids)
+    {
+        check_frame_idx_throw(id);
+    }
+
+    _contact_models.clear();
+    _contact_dim = 0;
+
+    for(int i = 0; i < link_ids.size(); i++)
+    {
+        const auto& frame = _mdl.frames[link_ids[i]];
+
+        auto type = types[i] == ContactType::Point3D ?
+                        pinocchio::CONTACT_3D : pinocchio::CONTACT_6D;
+
+        // contact forces are expressed in the getJacobian() convention
+        _contact_models.emplace_back(type,
+                                     _mdl,
+                                     frame.parent,
+                                     frame.placement,
+                                     _world_aligned);
+
+        _contact_dim += _contact_models.back().size();
+    }
+
+    // contact data and factorization must be re-initialized
+    _contacts_version++;
+}
+
+int ModelInterface2Pin::getContactDimension() const
+{
+    return _contact_dim;
+}
+
+void ModelInterface2Pin::computeConstrainedDynamics(VecRef ddq, VecRef lambda) const
+{
+    compute_constrained_dynamics(*_ws, model_state(), ddq, lambda);
+}
+
+void ModelInterface2Pin::computeConstrainedDynamics(Workspace& ws, VecRef ddq, VecRef lambda) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_constrained_dynamics(pws, pws.state(), ddq, lambda);
+}
+
+void ModelInterface2Pin::init_contact_data(WorkspacePin& ws) const
+{
+    // contact cholesky storage is only allocated when the contact set changes,
+    // and is then reused by all subsequent calls
+    if(ws.contacts_version == _contacts_version)
+    {
+        return;
+    }
+
+    ws.contact_data.clear();
+
+    for(const auto& cm : _contact_models)
+    {
+        ws.contact_data.emplace_back(cm);
+    }
+
+    pinocchio::initConstraintDynamics(_mdl, ws.data, _contact_models);
+
+    ws.tmp.constrained_lambda.setZero(_contact_dim);
+
+    ws.contacts_version = _contacts_version;
+
+    ws.cached_computation &= ~ConstrainedDynamics;
+}
+
+void ModelInterface2Pin::check_contact_output_size(VecConstRef x,
+                                                   VecConstRef lambda,
+                                                   const char * func) const
+{
+    check_mat_size(x, _mdl.nv, 1, func);
+    check_mat_size(lambda, _contact_dim, 1, func);
+}
+
+void ModelInterface2Pin::compute_constrained_dynamics(WorkspacePin& ws,
+                                                      const State& s,
+                                                      VecRef ddq,
+                                                      VecRef lambda) const
+{
+    check_contact_output_size(ddq, lambda, "computeConstrainedDynamics");
+
+    init_contact_data(ws);
+
+    if(!is_cached_for_effort(ws, ConstrainedDynamics, s, ws.tmp.constrained_dynamics_tau))
+    {
+        // exact (non-proximal) solution of the contact problem
+        pinocchio::ProximalSettings settings(1e-12, 0.0, 1);
+
+        pinocchio::constraintDynamics(_mdl, ws.data,
+                                      s.q, s.v, s.tau,
+                                      _contact_models, ws.contact_data,
+                                      settings);
+
+        ws.tmp.constrained_ddq = ws.data.ddq;
+        ws.tmp.constrained_lambda = ws.data.lambda_c;
+
+        // the spatial accelerations stored inside data
+        // are overwritten
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration | KinematicsDerivatives);
+
+        ws.cached_computation |= ConstrainedDynamics;
+    }
+
+    ddq = ws.tmp.constrained_ddq;
+    lambda = ws.tmp.constrained_lambda;
+}
+
+void ModelInterface2Pin::computeImpulseDynamics(VecRef v_after, VecRef impulse, double restitution) const
+{
+    compute_impulse_dynamics(*_ws, model_state(), v_after, impulse, restitution);
+}
+
+void ModelInterface2Pin::computeImpulseDynamics(Workspace& ws, VecRef v_after, VecRef impulse, double restitution) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_impulse_dynamics(pws, pws.state(), v_after, impulse, restitution);
+}
+
+void ModelInterface2Pin::compute_impulse_dynamics(WorkspacePin& ws,
+                                                  const State& s,
+                                                  VecRef v_after,
+                                                  VecRef impulse,
+                                                  double restitution) const
+{
+    check_contact_output_size(v_after, impulse, "computeImpulseDynamics");
+
+    // shares contact data and factorization storage with
+    // the constrained dynamics
+    init_contact_data(ws);
+
+    pinocchio::ProximalSettings settings(1e-12, 0.0, 1);
+
+    pinocchio::impulseDynamics(_mdl, ws.data,
+                               s.q, s.v,
+                               _contact_models, ws.contact_data,
+                               restitution,
+                               settings);
+
+    // note: joint velocities and accelerations inside data
+    // may refer to the post-impact state
+    ws.overwrite(KinematicsPosition);
+    ws.discard(KinematicsVelocity | KinematicsAcceleration | KinematicsDerivatives);
+
+    v_after = ws.data.dq_after;
+    impulse = ws.data.impulse_c;
+}
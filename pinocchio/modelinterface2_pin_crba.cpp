@@ -1,21 +1,117 @@
 #include "modelinterface2_pin.h"
 
 #include <pinocchio/algorithm/crba.hpp>
+#include <pinocchio/algorithm/cholesky.hpp>
 
 using namespace XBot;
 
 MatConstRef ModelInterface2Pin::computeInertiaMatrix() const
 {
-    if(!(_cached_computation & Crba))
+    return compute_inertia_matrix(*_ws, model_state());
+}
+
+MatConstRef ModelInterface2Pin::computeInertiaMatrix(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_inertia_matrix(pws, pws.state());
+}
+
+MatConstRef ModelInterface2Pin::compute_inertia_matrix(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Crba))
+    {
+        // note: the kernel fills the whole (symmetric) matrix
+        if(&ws != _ws.get() ||
+            !inertia_matrix_kernel(s.q, ws.data.M))
+        {
+            pinocchio::crba(_mdl, ws.data, s.q);
+
+            ws.overwrite(KinematicsPosition);
+
+            ws.data.M.triangularView<Eigen::StrictlyLower>() =
+                ws.data.M.transpose().triangularView<Eigen::StrictlyLower>();
+        }
+
+        ws.cached_computation |= Crba;
+    }
+
+    return ws.data.M;
+}
+
+bool ModelInterface2Pin::inertia_matrix_kernel(VecConstRef, MatRef) const
+{
+    return false;
+}
+
+void ModelInterface2Pin::compute_cholesky(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Cholesky))
     {
-        pinocchio::crba(_mdl, _data, getJointPosition());
+        compute_inertia_matrix(ws, s);
 
-        _data.M.triangularView<Eigen::StrictlyLower>() =
-            _data.M.transpose().triangularView<Eigen::StrictlyLower>();
+        // sparse M = U * D * U^T, following the kinematic tree
+        pinocchio::cholesky::decompose(_mdl, ws.data);
 
-        _cached_computation |= Crba;
+        ws.cached_computation |= Cholesky;
     }
+}
+
+void ModelInterface2Pin::computeInertiaInverseTimes(MatConstRef B, MatRef MinvB) const
+{
+    compute_inertia_inverse_times(*_ws, model_state(), B, MinvB);
+}
+
+void ModelInterface2Pin::computeInertiaInverseTimes(Workspace& ws, MatConstRef B, MatRef MinvB) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_inertia_inverse_times(pws, pws.state(), B, MinvB);
+}
+
+void ModelInterface2Pin::compute_inertia_inverse_times(WorkspacePin& ws,
+                                                       const State& s,
+                                                       MatConstRef B,
+                                                       MatRef MinvB) const
+{
+    check_mat_size(B, _mdl.nv, B.cols(), "computeInertiaInverseTimes");
+    check_mat_size(MinvB, _mdl.nv, B.cols(), "computeInertiaInverseTimes");
+
+    compute_cholesky(ws, s);
+
+    MinvB = B;
+
+    pinocchio::cholesky::solve(_mdl, ws.data, MinvB);
+}
+
+void ModelInterface2Pin::computeInverseOperationalSpaceInertia(MatConstRef J, MatRef Linv) const
+{
+    compute_inverse_operational_space_inertia(*_ws, model_state(), J, Linv);
+}
+
+void ModelInterface2Pin::computeInverseOperationalSpaceInertia(Workspace& ws, MatConstRef J, MatRef Linv) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_inverse_operational_space_inertia(pws, pws.state(), J, Linv);
+}
+
+void ModelInterface2Pin::compute_inverse_operational_space_inertia(WorkspacePin& ws,
+                                                                   const State& s,
+                                                                   MatConstRef J,
+                                                                   MatRef Linv) const
+{
+    check_mat_size(J, J.rows(), _mdl.nv, "computeInverseOperationalSpaceInertia");
+    check_mat_size(Linv, J.rows(), J.rows(), "computeInverseOperationalSpaceInertia");
+
+    compute_cholesky(ws, s);
+
+    // J * M^-1 * J^T = X^T * X, with X = D^-1/2 * U^-1 * J^T
+    auto& X = ws.tmp.uinv_jt;
+
+    X = J.transpose();
+
+    pinocchio::cholesky::Uiv(_mdl, ws.data, X);
+
+    X = ws.data.Dinv.cwiseSqrt().asDiagonal() * X;
 
-    return _data.M;
+    Linv.noalias() = X.transpose() * X;
 }
 
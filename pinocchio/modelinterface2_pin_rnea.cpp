@@ -1,53 +1,151 @@
 #include "modelinterface2_pin.h"
 
 #include <pinocchio/algorithm/rnea.hpp>
+#include <pinocchio/algorithm/rnea-derivatives.hpp>
 
 using namespace XBot;
 
 VecConstRef ModelInterface2Pin::computeInverseDynamics() const
 {
-    if(!(_cached_computation & Rnea))
-    {
+    return compute_inverse_dynamics(*_ws, model_state());
+}
+
+VecConstRef ModelInterface2Pin::computeInverseDynamics(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_inverse_dynamics(pws, pws.state());
+}
 
-        _tmp.rnea = pinocchio::rnea(_mdl, _data,
-                                    getJointPosition(),
-                                    getJointVelocity(),
-                                    getJointAcceleration());
+VecConstRef ModelInterface2Pin::compute_inverse_dynamics(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Rnea))
+    {
+        if(&ws != _ws.get() ||
+            !inverse_dynamics_kernel(s.q, s.v, s.a, ws.tmp.rnea))
+        {
+            ws.tmp.rnea = pinocchio::rnea(_mdl, ws.data,
+                                          s.q,
+                                          s.v,
+                                          s.a);
 
+            ws.overwrite(KinematicsPosition | KinematicsVelocity);
+            ws.discard(KinematicsAcceleration);
+        }
 
-        _cached_computation |= Rnea;
+        ws.cached_computation |= Rnea;
 
     }
 
-    return _tmp.rnea;
+    return ws.tmp.rnea;
+}
+
+bool ModelInterface2Pin::inverse_dynamics_kernel(VecConstRef, VecConstRef, VecConstRef,
+                                                 VecRef) const
+{
+    return false;
 }
 
 VecConstRef ModelInterface2Pin::computeGravityCompensation() const
 {
-    if(!(_cached_computation & Gcomp))
+    return compute_gravity_compensation(*_ws, model_state());
+}
+
+VecConstRef ModelInterface2Pin::computeGravityCompensation(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_gravity_compensation(pws, pws.state());
+}
+
+VecConstRef ModelInterface2Pin::compute_gravity_compensation(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, Gcomp))
     {
 
-        _tmp.gcomp = pinocchio::computeGeneralizedGravity(_mdl, _data,
-                                                         getJointPosition());
+        ws.tmp.gcomp = pinocchio::computeGeneralizedGravity(_mdl, ws.data,
+                                                            s.q);
 
+        ws.overwrite(KinematicsPosition);
 
-        _cached_computation |= Gcomp;
+        ws.cached_computation |= Gcomp;
 
     }
 
-    return _tmp.gcomp;
+    return ws.tmp.gcomp;
 }
 
 VecConstRef ModelInterface2Pin::computeNonlinearTerm() const
 {
-    if(!(_cached_computation & NonlinearEffects))
+    return compute_nonlinear_term(*_ws, model_state());
+}
+
+VecConstRef ModelInterface2Pin::computeNonlinearTerm(Workspace& ws) const
+{
+    auto& pws = workspace_cast(ws);
+    return compute_nonlinear_term(pws, pws.state());
+}
+
+VecConstRef ModelInterface2Pin::compute_nonlinear_term(WorkspacePin& ws, const State& s) const
+{
+    if(!is_cached(ws, NonlinearEffects))
     {
-        _tmp.h = pinocchio::nonLinearEffects(_mdl, _data,
-                                             getJointPosition(), getJointVelocity());
+        ws.tmp.h = pinocchio::nonLinearEffects(_mdl, ws.data,
+                                               s.q, s.v);
+
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration);
+
+        ws.cached_computation |= NonlinearEffects;
+
+    }
+
+    return ws.tmp.h;
+}
+
+void ModelInterface2Pin::computeInverseDynamicsDerivatives(MatRef dtau_dq,
+                                                           MatRef dtau_dv,
+                                                           MatRef dtau_da) const
+{
+    compute_inverse_dynamics_derivatives(*_ws, model_state(), dtau_dq, dtau_dv, dtau_da);
+}
+
+void ModelInterface2Pin::computeInverseDynamicsDerivatives(Workspace& ws,
+                                                           MatRef dtau_dq,
+                                                           MatRef dtau_dv,
+                                                           MatRef dtau_da) const
+{
+    auto& pws = workspace_cast(ws);
+    compute_inverse_dynamics_derivatives(pws, pws.state(), dtau_dq, dtau_dv, dtau_da);
+}
+
+void ModelInterface2Pin::compute_inverse_dynamics_derivatives(WorkspacePin& ws,
+                                                              const State& s,
+                                                              MatRef dtau_dq,
+                                                              MatRef dtau_dv,
+                                                              MatRef dtau_da) const
+{
+    if(!is_cached(ws, RneaDerivatives))
+    {
+        // note: results are stored inside data.dtau_dq, data.dtau_dv,
+        // and (upper triangular part only) data.M
+        pinocchio::computeRNEADerivatives(_mdl, ws.data,
+                                          s.q,
+                                          s.v,
+                                          s.a);
+
+        // data.M is the inertia matrix at the current q, share it with crba
+        ws.data.M.triangularView<Eigen::StrictlyLower>() =
+            ws.data.M.transpose().triangularView<Eigen::StrictlyLower>();
+
+        // note: data.dVdq, data.dAdq, data.dAdv are overwritten
+        ws.cached_computation &= ~KinematicsDerivatives;
 
-        _cached_computation |= NonlinearEffects;
+        ws.overwrite(KinematicsPosition | KinematicsVelocity);
+        ws.discard(KinematicsAcceleration);
 
+        ws.cached_computation |= RneaDerivatives | Crba;
     }
 
-    return _tmp.h;
+    dtau_dq = ws.data.dtau_dq;
+    dtau_dv = ws.data.dtau_dv;
+    dtau_da = ws.data.M;
 }
@@ -37,6 +37,19 @@ PYBIND11_MODULE(pyxbot2_collision, m) {
         .def("getWitnessPoints", py::overload_cast<bool>(&CollisionModel::getWitnessPoints, py::const_),
              py::arg("include_env") = false)
         .def("getOrderedCollisionPairIndices", &CollisionModel::getOrderedCollisionPairIndices)
+        .def("getActiveDistanceJacobian", [](const CollisionModel& self, double threshold, bool include_env)
+             {
+                 std::vector<int> active_idx;
+                 Eigen::MatrixXd J;
+                 self.getActiveDistanceJacobian(threshold, active_idx, J, include_env);
+                 return std::make_pair(active_idx, J);
+             },
+             py::arg("threshold"), py::arg("include_env") = false)
+        .def("setNumThreads", &CollisionModel::setNumThreads,
+             py::arg("num_threads"), py::arg("cpus") = std::vector<int>())
+        .def("getNumThreads", &CollisionModel::getNumThreads)
+        .def("setGjkWarmStart", &CollisionModel::setGjkWarmStart)
+        .def("getGjkWarmStart", &CollisionModel::getGjkWarmStart)
         ;
 
 }
@@ -52,6 +52,10 @@ PYBIND11_MODULE(pyxbot2_interface, m) {
         .value("MotorSide", Sync::MotorSide)
         .export_values();
 
+    py::enum_<ModelInterface::ContactType>(m, "ContactType")
+        .value("Point3D", ModelInterface::ContactType::Point3D)
+        .value("Frame6D", ModelInterface::ContactType::Frame6D);
+
     m.def("computeOrientationError",
           py::overload_cast<const Eigen::Matrix3d&, const Eigen::Matrix3d&>(Utils::computeOrientationError));
 
@@ -178,6 +182,18 @@ PYBIND11_MODULE(pyxbot2_interface, m) {
              py::overload_cast<string_const_ref>(&XBotInterface::getJacobianInWorld, py::const_))
         .def("getRelativeJacobian",
              py::overload_cast<string_const_ref, string_const_ref>(&XBotInterface::getRelativeJacobian, py::const_))
+        .def("getJacobianTimeVariation",
+             py::overload_cast<string_const_ref>(&XBotInterface::getJacobianTimeVariation, py::const_))
+        .def("getJacobianSupport",
+             py::overload_cast<string_const_ref>(&XBotInterface::getJacobianSupport, py::const_))
+        .def("getJacobianCompact",
+             [](const XBotInterface& self, string_const_ref link_name)
+             {
+                 int id = self.getLinkId(link_name);
+                 Eigen::MatrixXd Jc(6, self.getJacobianSupport(id).size());
+                 self.getJacobianCompact(id, Jc);
+                 return Jc;
+             })
         .def("computeInverseDynamics",
              py::overload_cast<>(&XBotInterface::computeInverseDynamics, py::const_))
         .def("computeForwardDynamics",
@@ -186,10 +202,46 @@ PYBIND11_MODULE(pyxbot2_interface, m) {
              py::overload_cast<>(&XBotInterface::computeInertiaMatrix, py::const_))
         .def("computeInertiaInverse",
              py::overload_cast<>(&XBotInterface::computeInertiaInverse, py::const_))
+        .def("computeInertiaInverseTimes",
+             [](const XBotInterface& self, const Eigen::MatrixXd& B)
+             {
+                 Eigen::MatrixXd MinvB(B.rows(), B.cols());
+                 self.computeInertiaInverseTimes(B, MinvB);
+                 return MinvB;
+             })
+        .def("computeOperationalSpaceInertia",
+             [](const XBotInterface& self, const std::vector<std::string>& link_names)
+             {
+                 std::vector<int> link_ids;
+                 for(const auto& l : link_names) link_ids.push_back(self.getLinkId(l));
+                 Eigen::MatrixXd Lambda(6*link_ids.size(), 6*link_ids.size());
+                 self.computeOperationalSpaceInertia(link_ids, Lambda);
+                 return Lambda;
+             })
+        .def("computeDynamicallyConsistentInverse",
+             [](const XBotInterface& self, const std::vector<std::string>& link_names)
+             {
+                 std::vector<int> link_ids;
+                 for(const auto& l : link_names) link_ids.push_back(self.getLinkId(l));
+                 Eigen::MatrixXd Jbar(self.getNv(), 6*link_ids.size());
+                 self.computeDynamicallyConsistentInverse(link_ids, Jbar);
+                 return Jbar;
+             })
+        .def("computeInverseOperationalSpaceInertia",
+             [](const XBotInterface& self, const Eigen::MatrixXd& J)
+             {
+                 Eigen::MatrixXd Linv(J.rows(), J.rows());
+                 self.computeInverseOperationalSpaceInertia(J, Linv);
+                 return Linv;
+             })
         .def("computeGravityCompensation",
              py::overload_cast<>(&XBotInterface::computeGravityCompensation, py::const_))
         .def("computeCentroidalMomentumMatrix",
              py::overload_cast<>(&XBotInterface::computeCentroidalMomentumMatrix, py::const_))
+        .def("computeCentroidalMomentumMatrixTimeVariation",
+             py::overload_cast<>(&XBotInterface::computeCentroidalMomentumMatrixTimeVariation, py::const_))
+        .def("computeCentroidalMomentumMatrixDotTimesV",
+             &XBotInterface::computeCentroidalMomentumMatrixDotTimesV)
         .def("computeNonlinearTerm",
              py::overload_cast<>(&XBotInterface::computeNonlinearTerm, py::const_))
         .def("__str__", [](const XBotInterface& self)
@@ -219,6 +271,100 @@ PYBIND11_MODULE(pyxbot2_interface, m) {
              py::overload_cast<>(&ModelInterface::getJoints), rvp::reference_internal)
         .def("generateReducedModel",
              &ModelInterface::generateReducedModel)
+        .def("setHotLinks",
+             py::overload_cast<const std::vector<std::string>&>(&ModelInterface::setHotLinks))
+        .def("getComputationStatistics",
+             &ModelInterface::getComputationStatistics)
+        .def("resetComputationStatistics",
+             &ModelInterface::resetComputationStatistics)
+        .def("setContacts",
+             py::overload_cast<const std::vector<std::string>&,
+                               const std::vector<ModelInterface::ContactType>&>(&ModelInterface::setContacts))
+        .def("getContactDimension",
+             &ModelInterface::getContactDimension)
+        .def("computeConstrainedDynamics",
+             [](const ModelInterface& self)
+             {
+                 Eigen::VectorXd ddq(self.getNv());
+                 Eigen::VectorXd lambda(self.getContactDimension());
+                 self.computeConstrainedDynamics(ddq, lambda);
+                 return std::make_tuple(ddq, lambda);
+             })
+        .def("computeImpulseDynamics",
+             [](const ModelInterface& self, double restitution)
+             {
+                 Eigen::VectorXd v_after(self.getNv());
+                 Eigen::VectorXd impulse(self.getContactDimension());
+                 self.computeImpulseDynamics(v_after, impulse, restitution);
+                 return std::make_tuple(v_after, impulse);
+             },
+             py::arg("restitution") = 0.0)
+        .def("getDynamicParameters",
+             &ModelInterface::getDynamicParameters)
+        .def("computeRegressor",
+             py::overload_cast<>(&ModelInterface::computeRegressor, py::const_))
+        .def("computeRegressorBatch",
+             [](const ModelInterface& self,
+                const Eigen::MatrixXd& Q,
+                const Eigen::MatrixXd& V,
+                const Eigen::MatrixXd& A,
+                int n_threads)
+             {
+                 ModelInterface::BatchData bd;
+                 bd.computation = ModelInterface::BatchData::Regressor;
+                 bd.resize(self, Q.cols());
+                 {
+                     py::gil_scoped_release release;
+                     self.evaluateBatch(Q, V, A, bd, n_threads);
+                 }
+                 return bd.regressor;
+             },
+             py::arg("Q"), py::arg("V"), py::arg("A"), py::arg("n_threads") = 1)
+        .def("computeInverseDynamicsDerivatives",
+             [](const ModelInterface& self)
+             {
+                 Eigen::MatrixXd dtau_dq(self.getNv(), self.getNv());
+                 Eigen::MatrixXd dtau_dv(self.getNv(), self.getNv());
+                 Eigen::MatrixXd dtau_da(self.getNv(), self.getNv());
+                 self.computeInverseDynamicsDerivatives(dtau_dq, dtau_dv, dtau_da);
+                 return std::make_tuple(dtau_dq, dtau_dv, dtau_da);
+             })
+        .def("computeCentroidalDynamicsDerivatives",
+             [](const ModelInterface& self)
+             {
+                 Eigen::MatrixXd dh_dq(6, self.getNv());
+                 Eigen::MatrixXd dhdot_dq(6, self.getNv());
+                 Eigen::MatrixXd dhdot_dv(6, self.getNv());
+                 Eigen::MatrixXd dhdot_da(6, self.getNv());
+                 self.computeCentroidalDynamicsDerivatives(dh_dq, dhdot_dq, dhdot_dv, dhdot_da);
+                 return std::make_tuple(dh_dq, dhdot_dq, dhdot_dv, dhdot_da);
+             })
+        .def("getVelocityTwistDerivatives",
+             [](const ModelInterface& self, string_const_ref link_name)
+             {
+                 Eigen::MatrixXd dv_dq(6, self.getNv());
+                 Eigen::MatrixXd dv_dv(6, self.getNv());
+                 self.getVelocityTwistDerivatives(self.getLinkId(link_name), dv_dq, dv_dv);
+                 return std::make_tuple(dv_dq, dv_dv);
+             })
+        .def("getAccelerationTwistDerivatives",
+             [](const ModelInterface& self, string_const_ref link_name)
+             {
+                 Eigen::MatrixXd da_dq(6, self.getNv());
+                 Eigen::MatrixXd da_dv(6, self.getNv());
+                 Eigen::MatrixXd da_da(6, self.getNv());
+                 self.getAccelerationTwistDerivatives(self.getLinkId(link_name), da_dq, da_dv, da_da);
+                 return std::make_tuple(da_dq, da_dv, da_da);
+             })
+        .def("computeForwardDynamicsDerivatives",
+             [](const ModelInterface& self)
+             {
+                 Eigen::MatrixXd dddq_dq(self.getNv(), self.getNv());
+                 Eigen::MatrixXd dddq_dv(self.getNv(), self.getNv());
+                 Eigen::MatrixXd dddq_dtau(self.getNv(), self.getNv());
+                 self.computeForwardDynamicsDerivatives(dddq_dq, dddq_dv, dddq_dtau);
+                 return std::make_tuple(dddq_dq, dddq_dv, dddq_dtau);
+             })
         .def("setJointPosition",
              py::overload_cast<VecConstRef>(&ModelInterface::setJointPosition))
         .def("setJointPosition",
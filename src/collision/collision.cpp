@@ -6,6 +6,8 @@
 #include <hpp/fcl/BVH/BVH_model.h>
 #include <fmt/format.h>
 
+#include <chrono>
+
 using namespace XBot::Collision;
 
 fcl::Transform3f tofcl(const Eigen::Affine3d& T)
@@ -35,17 +37,16 @@ CollisionModel::Impl::Impl(ModelInterface::ConstPtr model,
     _api(api),
     _model(model)
 {
+    _model_update_count = _model->getUpdateCount();
+
     parseCollisionObjects();
 
     generateAllPairs();
 
     removeDisabledPairs();
 
+    // note: this also builds the broadphase
     updateCollisionPairData();
-
-    makeCollisionManager();
-
-    _Jtmp.setZero(6, _model->getNv());
 }
 
 /**
@@ -344,7 +345,7 @@ void CollisionModel::Impl::updateCollisionPairData()
                 cpd.id2 = _model->getLinkId(l2);
 
                 cpd.drequest.enable_nearest_points = true;
-                // cpd.crequest.....
+                cpd.set_warm_start(_gjk_warm_start);
 
                 _collision_pair_data.emplace_back(std::move(cpd));
 
@@ -367,6 +368,7 @@ void CollisionModel::Impl::updateCollisionPairData()
 
     if(!_env_collision || _env_collision->coll_obj.size() == 0)
     {
+        makeCollisionManager();
         return;
     }
 
@@ -399,7 +401,7 @@ void CollisionModel::Impl::updateCollisionPairData()
                 cpd.id2 = -1;
 
                 cpd.drequest.enable_nearest_points = true;
-                // cpd.crequest.....
+                cpd.set_warm_start(_gjk_warm_start);
 
                 _collision_pair_data.emplace_back(std::move(cpd));
 
@@ -415,22 +417,266 @@ void CollisionModel::Impl::updateCollisionPairData()
             }
         }
     }
+
+    makeCollisionManager();
 }
 
 void CollisionModel::Impl::makeCollisionManager()
 {
-    // _manager = std::make_unique<fcl::DynamicAABBTreeCollisionManager>();
+    _env_manager = std::make_unique<fcl::DynamicAABBTreeCollisionManager>();
+
+    _bp_sweep.clear();
+
+    // narrowphase storage (note: no allocation takes place inside
+    // computeDistance() after this point, as each pair can be a
+    // broadphase candidate at most once)
+    _dist_work.reserve(_collision_pair_data.size());
+    _dist_cost.assign(_collision_pair_data.size(), 1e-6);
+    _dist_stamp.assign(_collision_pair_data.size(), 0);
+
+    if(!_bp_query)
+    {
+        // note: only the aabb of this object is ever used
+        _bp_query = std::make_shared<fcl::CollisionObject>(
+            std::make_shared<fcl::Sphere>(1e-3));
+    }
+
+    // assign an index to each object, robot objects first
+    std::map<fcl::CollisionObject*, int> robot_objects, env_objects;
+    std::set<fcl::CollisionObject*> env_active_objects;
+
+    for(const auto& cpd : _collision_pair_data)
+    {
+        robot_objects.emplace(cpd.o1.get(), robot_objects.size());
+
+        if(cpd.link2->is_world)
+        {
+            env_objects.emplace(cpd.o2.get(), env_objects.size());
+            env_active_objects.insert(cpd.o1.get());
+        }
+        else
+        {
+            robot_objects.emplace(cpd.o2.get(), robot_objects.size());
+        }
+    }
+
+    const int n_robot = robot_objects.size();
+
+    _bp_num_obj = n_robot + env_objects.size();
+    _bp_obj_idx.resize(_bp_num_obj);
+
+    for(auto [co, idx] : robot_objects)
+    {
+        _bp_obj_idx[idx] = idx;
+        co->setUserData(&_bp_obj_idx[idx]);
+
+        _bp_sweep.push_back({0.0, co, idx, env_active_objects.contains(co)});
+    }
+
+    for(auto [co, idx] : env_objects)
+    {
+        _bp_obj_idx[n_robot + idx] = n_robot + idx;
+        co->setUserData(&_bp_obj_idx[n_robot + idx]);
+
+        _env_manager->registerObject(co);
+    }
+
+    _env_manager->setup();
+
+    // self pairs are stored with both orderings
+    _bp_pair_table.assign(n_robot * _bp_num_obj, -1);
+
+    auto obj_idx = [](const CollisionObjectPtr& co)
+    {
+        return *static_cast<int*>(co->getUserData());
+    };
+
+    for(int i = 0; i < _collision_pair_data.size(); i++)
+    {
+        const auto& cpd = _collision_pair_data[i];
+
+        int i1 = obj_idx(cpd.o1);
+        int i2 = obj_idx(cpd.o2);
+
+        _bp_pair_table[i1*_bp_num_obj + i2] = i;
+
+        if(i2 < n_robot)
+        {
+            _bp_pair_table[i2*_bp_num_obj + i1] = i;
+        }
+    }
+}
+
+void CollisionModel::Impl::computeCandidatePairs(bool include_env, double threshold)
+{
+    struct CandidateCallback : fcl::CollisionCallBackBase
+    {
+        Impl * self;
+        int query_idx;
+
+        bool collide(fcl::CollisionObject * o1, fcl::CollisionObject * o2) override
+        {
+            // o2 is the dummy query object, the actual one is query_idx
+            self->set_candidate(query_idx, *static_cast<int*>(o1->getUserData()));
+
+            // do not stop the query
+            return false;
+        }
+    };
+
+    // note: only candidates are visited, so that the cost of this
+    // function does not grow with the number of culled pairs
+    _dist_work.clear();
+
+    // self pairs: sort robot objects along x (insertion sort is linear
+    // for the nearly sorted sequence left by the previous query), then
+    // sweep; any pair closer than the threshold has aabbs whose gap
+    // along all axes is smaller than the threshold
+    for(auto& item : _bp_sweep)
+    {
+        item.lo = item.co->getAABB().min_[0];
+    }
+
+    for(int i = 1; i < _bp_sweep.size(); i++)
+    {
+        auto item = _bp_sweep[i];
+
+        int j = i - 1;
+
+        for(; j >= 0 && _bp_sweep[j].lo > item.lo; j--)
+        {
+            _bp_sweep[j+1] = _bp_sweep[j];
+        }
+
+        _bp_sweep[j+1] = item;
+    }
+
+    for(int i = 0; i < _bp_sweep.size(); i++)
+    {
+        const auto& aabb_i = _bp_sweep[i].co->getAABB();
+
+        for(int j = i + 1;
+             j < _bp_sweep.size() && _bp_sweep[j].lo <= aabb_i.max_[0] + threshold;
+             j++)
+        {
+            const auto& aabb_j = _bp_sweep[j].co->getAABB();
+
+            if(aabb_j.min_[1] > aabb_i.max_[1] + threshold ||
+                aabb_i.min_[1] > aabb_j.max_[1] + threshold ||
+                aabb_j.min_[2] > aabb_i.max_[2] + threshold ||
+                aabb_i.min_[2] > aabb_j.max_[2] + threshold)
+            {
+                continue;
+            }
+
+            set_candidate(_bp_sweep[i].idx, _bp_sweep[j].idx);
+        }
+    }
+
+    // robot-env pairs: query the env tree with the aabb of each robot
+    // object that takes part in some robot-env pair, inflated by the
+    // threshold
+    if(include_env)
+    {
+        CandidateCallback cb;
+        cb.self = this;
+
+        for(const auto& item : _bp_sweep)
+        {
+            if(!item.env_active)
+            {
+                continue;
+            }
+
+            fcl::AABB& query_aabb = _bp_query->getAABB();
+            query_aabb = item.co->getAABB();
+            query_aabb.min_.array() -= threshold;
+            query_aabb.max_.array() += threshold;
+
+            cb.query_idx = item.idx;
+
+            _env_manager->collide(_bp_query.get(), &cb);
+        }
+    }
+
+    // pairs are processed in ascending order (note: in-place sort)
+    std::sort(_dist_work.begin(), _dist_work.end());
+}
+
+void CollisionModel::Impl::set_candidate(int obj_idx_1, int obj_idx_2)
+{
+    // note: obj_idx_1 is always a robot object
+    int i = _bp_pair_table[obj_idx_1*_bp_num_obj + obj_idx_2];
+
+    if(i >= 0)
+    {
+        _dist_work.push_back(i);
+    }
+}
+
+void CollisionModel::Impl::computeNarrowphaseDistance(double threshold)
+{
+    if(!_pool)
+    {
+        for(int i : _dist_work)
+        {
+            _collision_pair_data[i].compute_distance(*_model, threshold);
+        }
+
+        return;
+    }
+
+    // split the work into contiguous chunks of (roughly) equal estimated
+    // cost; each pair writes its own result, so that the output does not
+    // depend on the number of threads
+    const int nt = _pool->size();
+
+    double total_cost = 0;
+
+    for(int i : _dist_work)
+    {
+        total_cost += _dist_cost[i];
+    }
+
+    double acc_cost = 0;
+    int k = 0;
+
+    _dist_work_split[0] = 0;
+
+    for(int t = 1; t < nt; t++)
+    {
+        double target_cost = total_cost * t / nt;
+
+        while(k < _dist_work.size() &&
+               acc_cost + 0.5*_dist_cost[_dist_work[k]] < target_cost)
+        {
+            acc_cost += _dist_cost[_dist_work[k]];
+            k++;
+        }
+
+        _dist_work_split[t] = k;
+    }
+
+    _dist_work_split[nt] = _dist_work.size();
+
+    auto task = [this, threshold](int worker_idx)
+    {
+        for(int k = _dist_work_split[worker_idx]; k < _dist_work_split[worker_idx+1]; k++)
+        {
+            int i = _dist_work[k];
 
-    // for(auto& [lname, lc] : _link_collision_map)
-    // {
-    //     for(auto& obj : lc.coll_obj)
-    //     {
-    //         _manager->registerObject(&obj);
-    //         obj.setUserData((void*)(&lname));
-    //     }
-    // }
+            auto tic = std::chrono::steady_clock::now();
 
-    // _manager->setup();
+            _collision_pair_data[i].compute_distance(*_model, threshold);
+
+            std::chrono::duration<double> dt = std::chrono::steady_clock::now() - tic;
+
+            // low-pass filtered cost estimate
+            _dist_cost[i] = 0.9*_dist_cost[i] + 0.1*dt.count();
+        }
+    };
+
+    _pool->run(task);
 }
 
 bool CollisionModel::Impl::checkSelfCollision(std::vector<int>* coll_pair_ids,
@@ -444,17 +690,19 @@ bool CollisionModel::Impl::checkSelfCollision(std::vector<int>* coll_pair_ids,
         coll_pair_ids->clear();
     }
 
-    int id = 0;
+    // pairs whose aabbs are farther than the security margin cannot collide
+    computeCandidatePairs(include_env, std::max(threshold, 0.0));
 
-    for(auto& cpd : _collision_pair_data)
+    _stats.collision_queries++;
+
+    for(int id : _dist_work)
     {
-        if(!include_env && cpd.link2->is_world)
-        {
-            return ret;
-        }
+        auto& cpd = _collision_pair_data[id];
 
         cpd.compute_collision(*_model, threshold);
 
+        _stats.collision_pair_evaluations++;
+
         if(cpd.cresult.isCollision())
         {
             if(coll_pair_ids)
@@ -467,8 +715,6 @@ bool CollisionModel::Impl::checkSelfCollision(std::vector<int>* coll_pair_ids,
                 return true;
             }
         }
-
-        ++id;
     }
 
     return ret;
@@ -502,6 +748,11 @@ bool CollisionModel::Impl::addCollisionShape(string_const_ref name,
 
         uo.link_collision->updatePose(uo.collision_object, link_T_shape);
 
+        if(uo.link_collision->is_world)
+        {
+            _env_manager->update();
+        }
+
         return true;
     }
 
@@ -752,6 +1003,90 @@ bool CollisionModel::Impl::computeCollisionFree(VecRef q,
     return false;
 }
 
+void CollisionModel::Impl::get_active_pairs(double threshold,
+                                            bool include_env,
+                                            std::vector<int>& active_idx) const
+{
+    active_idx.clear();
+
+    int n_pairs = include_env ? _collision_pair_data.size() : _n_self_collision_pairs;
+
+    for(int i = 0; i < n_pairs; i++)
+    {
+        double d = get_distance(i);
+
+        if(std::isfinite(d) && d < threshold)
+        {
+            active_idx.push_back(i);
+        }
+    }
+}
+
+double CollisionModel::Impl::get_distance(int i) const
+{
+    if(is_culled(i))
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    return _collision_pair_data[i].dresult.min_distance;
+}
+
+bool CollisionModel::Impl::is_culled(int i) const
+{
+    return _dist_stamp[i] != _dist_query;
+}
+
+void CollisionModel::Impl::compute_distance_jacobian_row(int i,
+                                                         MatRef J,
+                                                         int row,
+                                                         const int * col_map) const
+{
+    const auto& cpd = _collision_pair_data[i];
+
+    const Eigen::Vector3d& n = cpd.dresult.normal;
+
+    // maps a column of the full jacobian to a column of J
+    auto col = [col_map](int c) { return col_map ? col_map[c] : c; };
+
+    // the jacobian of the witness point p is Jv + skew(p - p_l)^T Jw,
+    // hence n^T Jp = n^T Jv + ((p - p_l) x n)^T Jw; only the columns
+    // inside the link support can be non-zero
+    _stats.link_jacobian_evaluations += !cpd.link1->J_valid;
+
+    const auto& J1 = cpd.link1->getJacobian(*_model);
+
+    Eigen::Vector3d r = cpd.dresult.nearest_points[0] - cpd.link1->w_T_l.translation();
+    Eigen::Vector3d b = r.cross(n);
+
+    for(int c : cpd.link1->support)
+    {
+        J(row, col(c)) -= n.dot(J1.col(c).head<3>()) +
+                          b.dot(J1.col(c).tail<3>());
+    }
+
+    // if we're processing a robot-env collision pair,
+    // we don't need to add the contribution from link2 (i.e., env),
+    // as the world jacobian is zero
+    if(i >= _n_self_collision_pairs)
+    {
+        return;
+    }
+
+    _stats.link_jacobian_evaluations += !cpd.link2->J_valid;
+
+    const auto& J2 = cpd.link2->getJacobian(*_model);
+
+    r = cpd.dresult.nearest_points[1] - cpd.link2->w_T_l.translation();
+    b = r.cross(n);
+
+    for(int c : cpd.link2->support)
+    {
+        J(row, col(c)) += n.dot(J2.col(c).head<3>()) +
+                          b.dot(J2.col(c).tail<3>());
+    }
+}
+
 void CollisionModel::Impl::check_distance_called_throw(const char * func)
 {
     if(!(_cached_computation & Distance))
@@ -762,6 +1097,21 @@ void CollisionModel::Impl::check_distance_called_throw(const char * func)
     }
 }
 
+void CollisionModel::Impl::check_model_unchanged_throw(const char * func)
+{
+    // the model kinematics only change on its update(); note that setting
+    // the next configuration without updating the model is allowed
+    // (the joint position does not tell the configuration the
+    // kinematics were computed at)
+    if(_model->getUpdateCount() != _model_update_count)
+    {
+        throw std::runtime_error(
+            fmt::format("{} requires the model not to be updated "
+                        "since the last call to update()",
+                        func));
+    }
+}
+
 void CollisionModel::Impl::set_distance_called()
 {
     _cached_computation |= Distance;
@@ -857,6 +1207,12 @@ bool CollisionModel::moveCollisionShape(string_const_ref name, Eigen::Affine3d l
         return false;
     }
 
+    // environment aabbs have changed, refit the broadphase
+    if(lc->is_world)
+    {
+        impl->_env_manager->update();
+    }
+
     return true;
 }
 
@@ -915,6 +1271,65 @@ void CollisionModel::resetLinksVsEnvironment()
     impl->updateCollisionPairData();
 }
 
+void CollisionModel::setNumThreads(int num_threads, std::vector<int> cpus)
+{
+    if(num_threads == 1 && cpus.empty())
+    {
+        impl->_pool.reset();
+        return;
+    }
+
+    impl->_pool = std::make_unique<XBot::detail::ThreadPool>(num_threads, cpus);
+    impl->_dist_work_split.assign(num_threads + 1, 0);
+}
+
+int CollisionModel::getNumThreads() const
+{
+    return impl->_pool ? impl->_pool->size() : 1;
+}
+
+void CollisionModel::setGjkWarmStart(bool flag)
+{
+    impl->_gjk_warm_start = flag;
+
+    for(auto& cpd : impl->_collision_pair_data)
+    {
+        cpd.set_warm_start(flag);
+    }
+}
+
+std::map<std::string, uint64_t> CollisionModel::getComputationStatistics() const
+{
+    const auto& stats = impl->_stats;
+
+    std::map<std::string, uint64_t> ret = {
+        {"distance_queries", stats.distance_queries},
+        {"distance_pair_evaluations", stats.distance_pair_evaluations},
+        {"collision_queries", stats.collision_queries},
+        {"collision_pair_evaluations", stats.collision_pair_evaluations},
+        {"link_jacobian_evaluations", stats.link_jacobian_evaluations},
+        {"gjk_evaluations", stats.gjk_evaluations}
+    };
+
+    // not reported at all (rather than as zero) if it cannot be measured
+    if(Impl::ComputeDistance::has_gjk_iterations)
+    {
+        ret["gjk_iterations"] = stats.gjk_iterations;
+    }
+
+    return ret;
+}
+
+void CollisionModel::resetComputationStatistics()
+{
+    impl->_stats = Impl::Statistics();
+}
+
+bool CollisionModel::getGjkWarmStart() const
+{
+    return impl->_gjk_warm_start;
+}
+
 bool CollisionModel::checkSelfCollision(std::vector<int>& coll_pair_ids, double threshold)
 {
     return impl->checkSelfCollision(&coll_pair_ids, false, threshold);
@@ -942,6 +1357,8 @@ void CollisionModel::update()
         lc.second->update(*impl->_model);
     }
 
+    impl->_model_update_count = impl->_model->getUpdateCount();
+
     impl->_cached_computation = 0;
 }
 
@@ -964,6 +1381,12 @@ void CollisionModel::getNormals(std::vector<Eigen::Vector3d> &n, bool include_en
     {
         const auto& cpd = impl->_collision_pair_data[i];
 
+        if(impl->is_culled(i))
+        {
+            n[i].setZero();
+            continue;
+        }
+
         n[i] = cpd.dresult.normal;
     }
 }
@@ -990,6 +1413,13 @@ void CollisionModel::getWitnessPoints(
     {
         const auto& cpd = impl->_collision_pair_data[i];
 
+        if(impl->is_culled(i))
+        {
+            wp[i].first.setZero();
+            wp[i].second.setZero();
+            continue;
+        }
+
         wp[i].first = cpd.dresult.nearest_points[0];
         wp[i].second = cpd.dresult.nearest_points[1];
     }
@@ -1008,23 +1438,51 @@ void CollisionModel::computeDistance(Eigen::VectorXd& d,
                                      bool include_env,
                                      double threshold) const
 {
-    for(auto& item : impl->_collision_pair_data)
+    const int n_pairs = getNumCollisionPairs(include_env);
+
+    // with a positive threshold, distances are only computed for the
+    // pairs returned by the broadphase; all other ones are culled, i.e.
+    // they are not even visited
+    if(threshold > 0)
     {
-        // if id2 == -1 we have reached a robot-env collision pair,
-        // break the loop if include_env is false
-        if(item.id2 < 0 && !include_env)
+        impl->computeCandidatePairs(include_env, threshold);
+    }
+    else
+    {
+        impl->_dist_work.clear();
+
+        for(int i = 0; i < n_pairs; i++)
         {
-            break;
+            impl->_dist_work.push_back(i);
         }
+    }
 
-        item.compute_distance(*impl->_model, threshold);
+    impl->_dist_query++;
+
+    for(int i : impl->_dist_work)
+    {
+        impl->_dist_stamp[i] = impl->_dist_query;
+    }
+
+    impl->computeNarrowphaseDistance(threshold);
+
+    impl->_distance_threshold = threshold;
+
+    impl->_stats.distance_queries++;
+    impl->_stats.distance_pair_evaluations += impl->_dist_work.size();
+
+    for(int i : impl->_dist_work)
+    {
+        const auto& cpd = impl->_collision_pair_data[i];
+        impl->_stats.gjk_evaluations += cpd.gjk_evaluated;
+        impl->_stats.gjk_iterations += cpd.gjk_iterations;
     }
 
     impl->set_distance_called();
 
-    d.resize(getNumCollisionPairs(include_env));
+    d.setConstant(n_pairs, std::numeric_limits<double>::infinity());
 
-    for(int i = 0; i < d.size(); i++)
+    for(int i : impl->_dist_work)
     {
         d[i] = impl->_collision_pair_data[i].dresult.min_distance;
     }
@@ -1045,48 +1503,104 @@ void CollisionModel::getDistanceJacobian(MatRef J, bool include_env) const
 
     impl->check_distance_called_throw(__func__);
 
-    auto& model = *impl->_model;
+    impl->check_model_unchanged_throw(__func__);
 
-    auto& Jtmp = impl->_Jtmp;
+    for(int i = 0; i < J.rows(); i++)
+    {
+        J.row(i).setZero();
 
-    Jtmp.resize(6, model.getNv());
+        // pairs that are disabled, culled by the broadphase, or above the
+        // threshold of the last computeDistance() have a zero row, so that
+        // the jacobian of links that are far from contact is never computed
+        double d = impl->get_distance(i);
 
-    for(int i = 0; i < J.rows(); i++)
+        if(!std::isfinite(d) ||
+            (impl->_distance_threshold > 0 && d > impl->_distance_threshold))
+        {
+            continue;
+        }
+
+        impl->compute_distance_jacobian_row(i, J, i);
+    }
+}
+
+void CollisionModel::getActiveDistanceJacobian(double threshold,
+                                               std::vector<int>& active_idx,
+                                               Eigen::MatrixXd& J,
+                                               bool include_env) const
+{
+    impl->check_distance_called_throw(__func__);
+
+    impl->check_model_unchanged_throw(__func__);
+
+    impl->get_active_pairs(threshold, include_env, active_idx);
+
+    J.setZero(active_idx.size(), impl->_model->getNv());
+
+    for(int k = 0; k < active_idx.size(); k++)
+    {
+        impl->compute_distance_jacobian_row(active_idx[k], J, k);
+    }
+}
+
+void CollisionModel::getActiveDistanceJacobian(double threshold,
+                                               std::vector<int>& active_idx,
+                                               std::vector<int>& active_cols,
+                                               Eigen::MatrixXd& J,
+                                               bool include_env) const
+{
+    impl->check_distance_called_throw(__func__);
+
+    impl->check_model_unchanged_throw(__func__);
+
+    impl->get_active_pairs(threshold, include_env, active_idx);
+
+    // active columns are the union of the jacobian supports of
+    // all links involved in an active pair
+    auto& col_map = impl->_jacobian_col_map;
+
+    col_map.assign(impl->_model->getNv(), -1);
+
+    for(int i : active_idx)
     {
         const auto& cpd = impl->_collision_pair_data[i];
 
-        // translate J1 to witness point
-        Eigen::Vector3d r = cpd.dresult.nearest_points[0] - cpd.link1->w_T_l.translation();
-        Jtmp = cpd.link1->J;
-        XBot::Utils::changeRefPoint(Jtmp, r);
+        for(int c : cpd.link1->support)
+        {
+            col_map[c] = 0;
+        }
+
+        for(int c : cpd.link2->support)
+        {
+            col_map[c] = 0;
+        }
+    }
 
-        // update distance jacobian
-        J.row(i).noalias() = -cpd.dresult.normal.transpose() * Jtmp.topRows<3>();
+    active_cols.clear();
 
-        // if we're processing a robot-env collision pair,
-        // we don't need to add the contribution from link2 (i.e., env),
-        // as the world jacobian is zero
-        if(i >= impl->_n_self_collision_pairs)
+    for(int c = 0; c < col_map.size(); c++)
+    {
+        if(col_map[c] < 0)
         {
             continue;
         }
 
-        // translate J2 to witness point
-        r = cpd.dresult.nearest_points[1] - cpd.link2->w_T_l.translation();
-        Jtmp = cpd.link2->J;
-        XBot::Utils::changeRefPoint(Jtmp, r);
+        col_map[c] = active_cols.size();
+        active_cols.push_back(c);
+    }
 
-        // update distance jacobian
-        J.row(i).noalias() += cpd.dresult.normal.transpose() * Jtmp.topRows<3>();
+    J.setZero(active_idx.size(), active_cols.size());
 
+    for(int k = 0; k < active_idx.size(); k++)
+    {
+        impl->compute_distance_jacobian_row(active_idx[k], J, k, col_map.data());
     }
 }
 
 const std::vector<int> &CollisionModel::getOrderedCollisionPairIndices() const
 {
     std::sort(impl->_ordered_idx.begin(), impl->_ordered_idx.end(), [this](int a, int b) {
-        return impl->_collision_pair_data[a].dresult.min_distance <
-               impl->_collision_pair_data[b].dresult.min_distance;
+        return impl->get_distance(a) < impl->get_distance(b);
     });
 
     return impl->_ordered_idx;
@@ -1116,13 +1630,13 @@ void CollisionModel::Impl::CollisionPairData::compute_distance(const ModelInterf
 {
     dresult.clear();
 
+    gjk_evaluated = false;
+    gjk_iterations = 0;
+
     // one of the two collisions is disabled, return
     if(!link1->enabled[co_idx1] || !link2->enabled[co_idx2])
     {
-        dresult.min_distance = std::numeric_limits<double>::infinity();
-        dresult.normal.setZero();  // note: this makes jacobian be zero as we want
-        dresult.nearest_points[0].setZero();
-        dresult.nearest_points[1].setZero();
+        set_infinite_distance();
         return;
     }
 
@@ -1134,10 +1648,10 @@ void CollisionModel::Impl::CollisionPairData::compute_distance(const ModelInterf
                                               &dresult.nearest_points[0],
                                               &dresult.nearest_points[1]);
 
+    // same convention as the pairs culled by the broadphase
     if(threshold > 0 && aabb_dist > threshold)
     {
-        dresult.min_distance = aabb_dist;
-        dresult.normal = (dresult.nearest_points[1]-dresult.nearest_points[0]).normalized();
+        set_infinite_distance();
         return;
     }
 
@@ -1160,6 +1674,12 @@ void CollisionModel::Impl::CollisionPairData::compute_distance(const ModelInterf
          drequest,
          dresult);
 
+    gjk_evaluated = true;
+    gjk_iterations = dist.gjk_iterations();
+
+    // store the guess for the next query (no-op unless warm start is enabled)
+    drequest.updateGuess(dresult);
+
 
     // hack to fix wrong distance when in deep collision
     if(dresult.min_distance < 0)
@@ -1168,6 +1688,25 @@ void CollisionModel::Impl::CollisionPairData::compute_distance(const ModelInterf
     }
 }
 
+size_t CollisionModel::Impl::ComputeDistance::gjk_iterations() const
+{
+#if HPP_FCL_VERSION_AT_LEAST(3, 0, 0)
+    // note: for meshes, this refers to the last pair of primitives
+    return solver.gjk.getNumIterations();
+#else
+    return 0;
+#endif
+}
+
+void CollisionModel::Impl::CollisionPairData::set_infinite_distance()
+{
+    dresult.clear();
+    dresult.min_distance = std::numeric_limits<double>::infinity();
+    dresult.normal.setZero();  // note: this makes jacobian be zero as we want
+    dresult.nearest_points[0].setZero();
+    dresult.nearest_points[1].setZero();
+}
+
 void CollisionModel::Impl::CollisionPairData::compute_collision(const ModelInterface &model,
                                                                 double threshold)
 {
@@ -1199,6 +1738,18 @@ void CollisionModel::Impl::CollisionPairData::compute_collision(const ModelInter
          o2->getTransform(),
          crequest,
          cresult);
+
+    crequest.updateGuess(cresult);
+}
+
+void CollisionModel::Impl::CollisionPairData::set_warm_start(bool flag)
+{
+    // poses only change slightly between consecutive queries, so that the
+    // last separating direction is usually a very good initial guess
+    auto guess = flag ? fcl::GJKInitialGuess::CachedGuess : fcl::GJKInitialGuess::DefaultGuess;
+
+    drequest.gjk_initial_guess = guess;
+    crequest.gjk_initial_guess = guess;
 }
 
 
@@ -1232,6 +1783,11 @@ CollisionModel::Impl::LinkCollision::LinkCollision(const ModelInterface &model,
         {
             throw std::runtime_error("link '" + link_name + "' undefined");
         }
+
+        support = model.getJacobianSupport(link_id);
+
+        // note: jacobian is only computed if needed by getJacobian()
+        J.setZero(6, model.getNv());
     }
 
     if(geoms.size() != l_T_shape.size())
@@ -1256,7 +1812,7 @@ CollisionModel::Impl::LinkCollision::LinkCollision(const ModelInterface &model,
         obj->computeAABB();
     }
 
-    J = model.getJacobian(link_name);
+    J_valid = is_world;
 }
 
 void CollisionModel::Impl::LinkCollision::update(const ModelInterface &model)
@@ -1271,7 +1827,8 @@ void CollisionModel::Impl::LinkCollision::update(const ModelInterface &model)
 
     w_T_l = model.getPose(link_id);
 
-    model.getJacobian(link_id, J);
+    // note: jacobian is only computed if needed by getJacobian()
+    J_valid = false;
 
     for(int i = 0; i < coll_obj.size(); i++)
     {
@@ -1283,6 +1840,17 @@ void CollisionModel::Impl::LinkCollision::update(const ModelInterface &model)
     }
 }
 
+const Eigen::MatrixXd& CollisionModel::Impl::LinkCollision::getJacobian(const ModelInterface &model)
+{
+    if(!J_valid)
+    {
+        model.getJacobian(link_id, J);
+        J_valid = true;
+    }
+
+    return J;
+}
+
 void CollisionModel::Impl::LinkCollision::updatePose(CollisionObjectPtr co,
                                                      const Eigen::Affine3d &pose)
 {
@@ -3,9 +3,13 @@
 
 #include <xbot2_interface/collision.h>
 
+#include "../impl/thread_pool.hxx"
+
+#include <hpp/fcl/config.hh>
 #include <hpp/fcl/collision.h>
 #include <hpp/fcl/distance.h>
 #include <hpp/fcl/broadphase/broadphase.h>
+#include <hpp/fcl/broadphase/broadphase_dynamic_AABB_tree.h>
 
 
 namespace fcl = hpp::fcl;
@@ -31,6 +35,12 @@ public:
 
     void makeCollisionManager();
 
+    void computeCandidatePairs(bool include_env, double threshold);
+
+    void set_candidate(int obj_idx_1, int obj_idx_2);
+
+    void computeNarrowphaseDistance(double threshold);
+
     //
 
     bool checkSelfCollision(std::vector<int> * coll_pair_ids, bool include_env, double threshold);
@@ -44,16 +54,29 @@ public:
     bool computeCollisionFree(VecRef q,
                               ComputeCollisionFreeOptions opt);
 
+    void get_active_pairs(double threshold,
+                          bool include_env,
+                          std::vector<int>& active_idx) const;
+
+    double get_distance(int i) const;
+
+    bool is_culled(int i) const;
+
+    void compute_distance_jacobian_row(int i,
+                                       MatRef J,
+                                       int row,
+                                       const int * col_map = nullptr) const;
+
     void check_distance_called_throw(const char * func);
 
+    void check_model_unchanged_throw(const char * func);
+
     void set_distance_called();
 
 private:
 
     CollisionModel& _api;
 
-    Eigen::MatrixXd _Jtmp;
-
     ModelInterface::ConstPtr _model;
 
     typedef std::pair<std::string, std::string> LinkPair;
@@ -71,6 +94,8 @@ private:
 
         void update(const ModelInterface& model);
 
+        const Eigen::MatrixXd& getJacobian(const ModelInterface& model);
+
         void updatePose(CollisionObjectPtr co, const Eigen::Affine3d& link_T_shape);
 
         Eigen::Affine3d getPose(CollisionObjectPtr co) const;
@@ -85,7 +110,11 @@ private:
         int link_id;
         std::string link_name;
         Eigen::Affine3d w_T_l;
+
+        // jacobian is computed on demand, at most once per update()
         Eigen::MatrixXd J;
+        bool J_valid;
+        std::vector<int> support;
 
         std::vector<Eigen::Affine3d> l_T_shape;
         std::vector<CollisionObjectPtr> coll_obj;
@@ -93,9 +122,20 @@ private:
         std::vector<std::set<std::string>> disabled_collisions;
     };
 
+    // exposes the number of iterations of the last GJK run (only
+    // available with hpp-fcl >= 3, where the solver owns its GJK instance)
+    struct ComputeDistance : fcl::ComputeDistance
+    {
+        using fcl::ComputeDistance::ComputeDistance;
+
+        static constexpr bool has_gjk_iterations = HPP_FCL_VERSION_AT_LEAST(3, 0, 0);
+
+        size_t gjk_iterations() const;
+    };
+
     struct CollisionPairData
     {
-        fcl::ComputeDistance dist;
+        ComputeDistance dist;
         fcl::DistanceRequest drequest;
         fcl::DistanceResult dresult;
 
@@ -103,6 +143,11 @@ private:
         fcl::CollisionRequest crequest;
         fcl::CollisionResult cresult;
 
+        // whether the last distance query ran the narrowphase,
+        // and its number of GJK iterations
+        bool gjk_evaluated = false;
+        size_t gjk_iterations = 0;
+
         CollisionObjectPtr o1, o2;
         LinkCollision::Ptr link1, link2;
         int co_idx1, co_idx2;
@@ -113,6 +158,10 @@ private:
 
         void compute_distance(const ModelInterface &model, double threshold = -1);
 
+        void set_infinite_distance();
+
+        void set_warm_start(bool flag);
+
         void compute_collision(const ModelInterface &model, double threshold = -1);
     };
 
@@ -125,6 +174,37 @@ private:
 
     mutable uint16_t _cached_computation = 0;
 
+    // pairs whose stamp differs from the counter of computeDistance() calls
+    // were culled by the last query, and are reported with infinite distance
+    uint64_t _dist_query = 0;
+    std::vector<uint64_t> _dist_stamp;
+
+    // counters returned by getComputationStatistics()
+    struct Statistics
+    {
+        uint64_t distance_queries = 0;
+        uint64_t distance_pair_evaluations = 0;
+        uint64_t collision_queries = 0;
+        uint64_t collision_pair_evaluations = 0;
+        uint64_t link_jacobian_evaluations = 0;
+        uint64_t gjk_evaluations = 0;
+        uint64_t gjk_iterations = 0;
+    };
+
+    mutable Statistics _stats;
+
+    // model update count as of the last update(); link jacobians are
+    // computed lazily, and must refer to the same kinematic state
+    uint64_t _model_update_count = 0;
+
+    // threshold passed to the last computeDistance(); pairs above it
+    // do not contribute to the distance jacobian
+    double _distance_threshold = -1;
+
+    // if true, each pair's GJK is initialized with the separating
+    // direction and support guess from its previous query
+    bool _gjk_warm_start = true;
+
     // distances are computed for each item in this vector
     std::vector<CollisionPairData> _collision_pair_data;
     LinkPairVector _collision_pairs, _collision_pairs_no_env;
@@ -137,6 +217,44 @@ private:
     // filling _collision_pair_data
     std::set<LinkPair> _active_link_pairs;
 
+    // broadphase: robot objects are sorted along the x axis at each query
+    // (sweep and prune), whereas environment objects are kept inside a
+    // dynamic AABB tree, which is refitted when one of them is moved
+    struct SweepItem
+    {
+        double lo;
+        fcl::CollisionObject * co;
+        int idx;
+        bool env_active;
+    };
+
+    std::vector<SweepItem> _bp_sweep;
+    std::unique_ptr<fcl::DynamicAABBTreeCollisionManager> _env_manager;
+
+    // dummy object holding the (inflated) aabb the env tree is queried with
+    CollisionObjectPtr _bp_query;
+
+    // broadphase index of each object (robot objects first), which the
+    // objects' user data points to
+    std::vector<int> _bp_obj_idx;
+
+    // flat table (robot object idx, object idx) -> index inside
+    // _collision_pair_data (-1 if the two objects do not form a pair)
+    std::vector<int> _bp_pair_table;
+    int _bp_num_obj = 0;
+
+    // narrowphase: indices of the pairs whose distance must be computed
+    // (i.e. all of them, or the broadphase candidates in ascending order),
+    // and their (measured) computation time, which is used to split them
+    // among the threads of the pool (if any)
+    std::vector<int> _dist_work;
+    std::vector<double> _dist_cost;
+    std::vector<int> _dist_work_split;
+    std::unique_ptr<XBot::detail::ThreadPool> _pool;
+
+    // full -> compact column map for getActiveDistanceJacobian()
+    std::vector<int> _jacobian_col_map;
+
     // internal storage for the vector of ordered collision pair
     // indices (ascending distance)
     std::vector<int> _ordered_idx;
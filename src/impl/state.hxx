@@ -1,6 +1,10 @@
 #ifndef STATE_HXX
 #define STATE_HXX
 
+#include <cstdlib>
+#include <memory>
+#include <new>
+
 #include <xbot2_interface/common/types.h>
 
 #include "utils.h"
@@ -183,13 +187,99 @@ void resize(T& cnt, int nq, int nv, int nj)
 
 }
 
+// the owning state stores all its vectors inside a single
+// contiguous buffer, each of them starting on a cache line
+typedef Eigen::Map<Eigen::VectorXd, Eigen::Aligned64> StateVector;
+
+typedef StateTemplate<Eigen::Ref<Eigen::VectorXd>> StateView;
+
+struct State : StateTemplate<StateVector>
+{
+    State():
+        StateTemplate<StateVector>{
+            empty(), empty(), empty(), empty(),
+            empty(), empty(), empty(), empty(),
+            empty(), empty(), empty(), empty(),
+            empty(), empty(), empty(), empty()
+        },
+        buffer(nullptr, &std::free)
+    {
+    }
+
+    // vectors are views over the buffer
+    State(const State&) = delete;
+    State& operator=(const State&) = delete;
+
+    std::unique_ptr<double[], decltype(&std::free)> buffer;
+
+    static constexpr int cache_line_doubles = 64 / sizeof(double);
+
+private:
+
+    static StateVector empty()
+    {
+        return StateVector(nullptr, 0);
+    }
+};
+
+inline void resize(State& cnt, int nq, int nv, int nj)
+{
+    // frequently accessed quantities first
+    const std::pair<StateVector*, int> layout[] = {
+        {&cnt.qlink, nq}, {&cnt.vlink, nv}, {&cnt.a, nv}, {&cnt.tau, nv},
+        {&cnt.qref, nq}, {&cnt.vref, nv}, {&cnt.tauref, nv},
+        {&cnt.qmot, nq}, {&cnt.vmot, nv}, {&cnt.k, nv}, {&cnt.d, nv},
+        {&cnt.qmin, nv}, {&cnt.qmax, nv}, {&cnt.vmax, nv}, {&cnt.taumax, nv},
+        {&cnt.qneutral, nq}
+    };
+
+    auto padded = [](int n)
+    {
+        return (n + State::cache_line_doubles - 1) /
+               State::cache_line_doubles * State::cache_line_doubles;
+    };
+
+    size_t size = 0;
+
+    for(const auto& [vec, n] : layout)
+    {
+        size += padded(n);
+    }
+
+    // note: size is a multiple of the alignment, as required by aligned_alloc
+    cnt.buffer.reset(size > 0 ?
+                         static_cast<double*>(std::aligned_alloc(64, size*sizeof(double))) :
+                         nullptr);
+
+    if(size > 0 && !cnt.buffer)
+    {
+        throw std::bad_alloc();
+    }
+
+    double * ptr = cnt.buffer.get();
+
+    for(const auto& [vec, n] : layout)
+    {
+        // note: Map cannot be re-assigned, it must be re-constructed
+        new (vec) StateVector(n > 0 ? ptr : nullptr, n);
+        vec->setZero();
+        ptr += padded(n);
+    }
+
+    cnt.qnames.assign(nq, "");
+
+    cnt.vnames.assign(nv, "");
+
+    cnt.jnames.assign(nj, "");
+}
+
 template <typename Vec>
-typename StateTemplate<Vec>::ViewContainer createView(StateTemplate<Vec>& cnt,
-                                                      int iq, int nq,
-                                                      int iv, int nv,
-                                                      int ij, int nj)
+StateView createView(StateTemplate<Vec>& cnt,
+                     int iq, int nq,
+                     int iv, int nv,
+                     int ij, int nj)
 {
-    typename StateTemplate<Vec>::ViewContainer ret {
+    StateView ret {
         cnt.qmot.segment(iq, nq),
         cnt.qlink.segment(iq, nq),
         cnt.vmot.segment(iv, nv),
@@ -242,10 +332,8 @@ typename CommandTemplate<Vec, VecInt>::ViewContainer createView(CommandTemplate<
     return ret;
 }
 
-typedef StateTemplate<Eigen::VectorXd> State;
 typedef CommandTemplate<Eigen::VectorXd, Eigen::CtrlModeVector> Command;
 
-typedef StateTemplate<State::ViewType> StateView;
 typedef CommandTemplate<Command::ViewType, Command::ViewTypeInt> CommandView;
 
 } }
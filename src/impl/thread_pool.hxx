@@ -0,0 +1,82 @@
+#ifndef THREAD_POOL_HXX
+#define THREAD_POOL_HXX
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <xbot2_interface/common/visibility.h>
+
+namespace XBot::detail {
+
+/**
+ * @brief ThreadPool is a minimal fork-join pool with persistent
+ * workers; run() executes a task on all workers (the calling
+ * thread being worker #0) and returns when all of them are done.
+ * No memory is allocated after construction (unless a task throws).
+ *
+ * @note an exception thrown by the task on any worker is caught, and
+ * rethrown by run() once all workers are done (if several workers
+ * throw, the one with the lowest index is rethrown)
+ */
+class XBOT2IFC_API ThreadPool
+{
+
+public:
+
+    typedef void (*Task)(void * ctx, int worker_idx);
+
+    /**
+     * @param num_threads: total number of threads, including the caller
+     * @param cpus: if not empty, the i-th worker thread is pinned to cpus[i-1]
+     * @throw std::invalid_argument if some cpu index is out of range, and
+     * std::runtime_error if a worker thread cannot be pinned
+     */
+    ThreadPool(int num_threads, std::vector<int> cpus = {});
+
+    int size() const;
+
+    void run(Task task, void * ctx);
+
+    template <typename F>
+    void run(F& f)
+    {
+        run([](void * ctx, int worker_idx) { (*static_cast<F*>(ctx))(worker_idx); }, &f);
+    }
+
+    ~ThreadPool();
+
+private:
+
+    void worker_loop(int worker_idx);
+
+    void start_workers(int num_threads, const std::vector<int>& cpus);
+
+    void stop_workers();
+
+    void rethrow_errors();
+
+    std::vector<std::thread> _workers;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+
+    std::atomic<uint64_t> _generation;
+    std::atomic<int> _pending;
+    std::atomic<bool> _stop;
+
+    Task _task;
+    void * _ctx;
+
+    // exception thrown by each worker during the last run()
+    std::vector<std::exception_ptr> _errors;
+
+};
+
+}
+
+#endif // THREAD_POOL_HXX
@@ -1,13 +1,16 @@
 #ifndef XBOTINTERFACE2_HXX
 #define XBOTINTERFACE2_HXX
 
+#include <array>
 #include <map>
+#include <mutex>
 #include <string>
 
 #include <xbot2_interface/xbotinterface2.h>
 #include "state.hxx"
 #include "chain.hxx"
 #include "joint.hxx"
+#include "thread_pool.hxx"
 
 
 namespace XBot {
@@ -42,6 +45,21 @@ public:
 
     int get_link_id_throw(string_const_ref link_name) const;
 
+    const Eigen::LDLT<Eigen::MatrixXd>& get_inertia_ldlt();
+
+    // operational space inertia for link_ids
+    struct OsiCache
+    {
+        bool dirty = true;
+        bool jbar_dirty = true;
+        uint64_t last_used = 0;
+        std::vector<int> link_ids;
+        Eigen::MatrixXd J, Linv, Lambda, Jbar, MinvJt;
+        Eigen::LDLT<Eigen::MatrixXd> ldlt;
+    };
+
+    OsiCache& compute_operational_space_inertia(const std::vector<int>& link_ids);
+
     void finalize();
 
 private:
@@ -70,6 +88,10 @@ private:
     // link id to name
     std::map<int, std::string> _link_id_to_name;
 
+    // link id to jacobian support (non-zero columns)
+    std::unordered_map<int, std::vector<int>> _link_support;
+    std::vector<int> _full_support;
+
     // model state
     detail::State _state;
 
@@ -125,12 +147,27 @@ private:
         Eigen::LDLT<Eigen::MatrixXd> ldlt;
         Eigen::MatrixXd M;
 
+        // operational space inertia: several link sets (e.g. one per task) are cached at the same
+        // time, the least recently used one is replaced
+        static constexpr int OSI_CACHE_SIZE = 4;
+        std::array<OsiCache, OSI_CACHE_SIZE> osi_cache;
+        uint64_t osi_clock = 0;
+        std::vector<int> osi_single_link;
+
         void setZero(int nq, int nv);
         void setDirty();
     };
 
     Temporaries _tmp;
 
+    // number of update() calls so far
+    uint64_t _update_count = 0;
+
+    // persistent workers for ModelInterface::evaluateBatch(); the mutex
+    // serializes concurrent calls, as they share the plugin's batch workspaces
+    std::unique_ptr<detail::ThreadPool> _batch_pool;
+    std::mutex _batch_mtx;
+
 
 
 
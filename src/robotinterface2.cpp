@@ -289,6 +289,11 @@ Eigen::Vector6d RobotInterface::getJdotTimesV(int link_id) const
     return r_impl->_model->getJdotTimesV(link_id);
 }
 
+void RobotInterface::getJacobianTimeVariation(int link_id, MatRef dJ) const
+{
+    return r_impl->_model->getJacobianTimeVariation(link_id, dJ);
+}
+
 Eigen::Vector3d RobotInterface::getCOM() const
 {
     return r_impl->_model->getCOM();
@@ -358,3 +363,8 @@ Eigen::Vector6d RobotInterface::computeCentroidalMomentum() const
 {
     return r_impl->_model->computeCentroidalMomentum();
 }
+
+MatConstRef RobotInterface::computeCentroidalMomentumMatrixTimeVariation() const
+{
+    return r_impl->_model->computeCentroidalMomentumMatrixTimeVariation();
+}
@@ -0,0 +1,245 @@
+#include "impl/thread_pool.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+using namespace XBot::detail;
+
+namespace {
+
+// number of polls before a worker goes to sleep: requests usually
+// come at a high rate (i.e. every control cycle), and waking up a
+// sleeping thread is comparable to the whole narrowphase cost
+constexpr int SPIN_COUNT = 1 << 14;
+
+// hint the cpu that we are busy waiting, so that the sibling
+// hyperthread is not starved and the loop exit is not mispredicted
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+}
+
+ThreadPool::ThreadPool(int num_threads, std::vector<int> cpus):
+    _generation(0),
+    _pending(0),
+    _stop(false),
+    _task(nullptr),
+    _ctx(nullptr),
+    _errors(std::max(num_threads, 1))
+{
+    if(num_threads < 1)
+    {
+        throw std::invalid_argument(
+            fmt::format("num_threads must be at least one (got {})", num_threads));
+    }
+
+    if(!cpus.empty() && cpus.size() != num_threads - 1)
+    {
+        throw std::invalid_argument(
+            fmt::format("cpus.size() must be equal to the number of worker threads: {} != {}",
+                        cpus.size(), num_threads - 1));
+    }
+
+    for(int c : cpus)
+    {
+#ifdef __linux__
+        if(c < 0 || c >= CPU_SETSIZE)
+        {
+            throw std::invalid_argument(
+                fmt::format("cpu index must be in [0, {}) (got {})", CPU_SETSIZE, c));
+        }
+#else
+        throw std::invalid_argument("pinning worker threads is only supported on linux");
+#endif
+    }
+
+    try
+    {
+        start_workers(num_threads, cpus);
+    }
+    catch(...)
+    {
+        // the destructor is not called if the constructor throws, and
+        // destroying a joinable thread terminates the program
+        stop_workers();
+        throw;
+    }
+}
+
+void ThreadPool::start_workers(int num_threads, const std::vector<int>& cpus)
+{
+    _workers.reserve(num_threads - 1);
+
+    for(int i = 1; i < num_threads; i++)
+    {
+        _workers.emplace_back(&ThreadPool::worker_loop, this, i);
+
+        if(cpus.empty())
+        {
+            continue;
+        }
+
+#ifdef __linux__
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpus[i-1], &cpuset);
+
+        int ret = pthread_setaffinity_np(_workers.back().native_handle(),
+                                         sizeof(cpuset), &cpuset);
+
+        if(ret != 0)
+        {
+            throw std::runtime_error(
+                fmt::format("could not pin worker #{} to cpu {}: {}",
+                            i, cpus[i-1], std::strerror(ret)));
+        }
+#endif
+    }
+}
+
+int ThreadPool::size() const
+{
+    return _workers.size() + 1;
+}
+
+void ThreadPool::run(Task task, void * ctx)
+{
+    if(_workers.empty())
+    {
+        task(ctx, 0);
+        return;
+    }
+
+    _task = task;
+    _ctx = ctx;
+    _pending.store(_workers.size(), std::memory_order_relaxed);
+
+    {
+        std::lock_guard lock(_mtx);
+        _generation.fetch_add(1, std::memory_order_release);
+    }
+
+    _cv.notify_all();
+
+    // the calling thread is worker #0; note: ctx must outlive all
+    // workers, so that we must wait for them even if the task throws
+    try
+    {
+        task(ctx, 0);
+    }
+    catch(...)
+    {
+        _errors[0] = std::current_exception();
+    }
+
+    while(_pending.load(std::memory_order_acquire) > 0)
+    {
+        std::this_thread::yield();
+    }
+
+    rethrow_errors();
+}
+
+void ThreadPool::rethrow_errors()
+{
+    std::exception_ptr error;
+
+    for(auto& e : _errors)
+    {
+        if(e && !error)
+        {
+            error = e;
+        }
+
+        e = nullptr;
+    }
+
+    if(error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::worker_loop(int worker_idx)
+{
+    uint64_t seen = 0;
+
+    auto has_work = [&]()
+    {
+        return _generation.load(std::memory_order_acquire) != seen ||
+               _stop.load(std::memory_order_relaxed);
+    };
+
+    while(true)
+    {
+        int spin = 0;
+
+        while(!has_work() && spin < SPIN_COUNT)
+        {
+            cpu_relax();
+            spin++;
+        }
+
+        if(!has_work())
+        {
+            std::unique_lock lock(_mtx);
+            _cv.wait(lock, has_work);
+        }
+
+        if(_stop.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        seen = _generation.load(std::memory_order_acquire);
+
+        // exceptions are rethrown by run() on the calling thread
+        try
+        {
+            _task(_ctx, worker_idx);
+        }
+        catch(...)
+        {
+            _errors[worker_idx] = std::current_exception();
+        }
+
+        _pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop_workers();
+}
+
+void ThreadPool::stop_workers()
+{
+    {
+        std::lock_guard lock(_mtx);
+        _stop = true;
+    }
+
+    _cv.notify_all();
+
+    for(auto& w : _workers)
+    {
+        if(w.joinable())
+        {
+            w.join();
+        }
+    }
+
+    _workers.clear();
+}
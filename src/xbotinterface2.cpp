@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <fstream>
+#include <numeric>
+#include <thread>
 
 #include <xbot2_interface/common/plugin.h>
 #include <xbot2_interface/common/utils.h>
@@ -590,6 +593,491 @@ bool ModelInterface::setFloatingBaseTwist(const Eigen::Vector6d &twist)
     return true;
 }
 
+void ModelInterface::computeInverseDynamicsDerivatives(MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeForwardDynamicsDerivatives(MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeCentroidalDynamicsDerivatives(MatRef, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::setContacts(const std::vector<int>&, const std::vector<ContactType>&)
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+bool ModelInterface::setContacts(const std::vector<std::string>& link_names,
+                                 const std::vector<ContactType>& types)
+{
+    std::vector<int> link_ids;
+
+    for(const auto& lname : link_names)
+    {
+        int id = impl->get_link_id_error(lname);
+
+        if(id < 0)
+        {
+            return false;
+        }
+
+        link_ids.push_back(id);
+    }
+
+    setContacts(link_ids, types);
+
+    return true;
+}
+
+int ModelInterface::getContactDimension() const
+{
+    return 0;
+}
+
+Eigen::VectorXd ModelInterface::getDynamicParameters() const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeRegressor() const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeConstrainedDynamics(VecRef, VecRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeImpulseDynamics(VecRef, VecRef, double) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getVelocityTwistDerivatives(int, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getAccelerationTwistDerivatives(int, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::setHotLinks(const std::vector<int>&)
+{
+    // default implementation ignores the hint
+}
+
+bool ModelInterface::setHotLinks(const std::vector<std::string>& link_names)
+{
+    std::vector<int> link_ids;
+    link_ids.reserve(link_names.size());
+
+    for(const auto& lname : link_names)
+    {
+        int id = impl->get_link_id_error(lname);
+
+        if(id < 0)
+        {
+            return false;
+        }
+
+        link_ids.push_back(id);
+    }
+
+    setHotLinks(link_ids);
+
+    return true;
+}
+
+std::map<std::string, uint64_t> ModelInterface::getComputationStatistics() const
+{
+    return {};
+}
+
+void ModelInterface::resetComputationStatistics()
+{
+
+}
+
+VecConstRef ModelInterface::Workspace::getJointPosition() const
+{
+    return _q;
+}
+
+VecConstRef ModelInterface::Workspace::getJointVelocity() const
+{
+    return _v;
+}
+
+VecConstRef ModelInterface::Workspace::getJointAcceleration() const
+{
+    return _a;
+}
+
+VecConstRef ModelInterface::Workspace::getJointEffort() const
+{
+    return _tau;
+}
+
+ModelInterface::Workspace::~Workspace()
+{
+
+}
+
+ModelInterface::Workspace::UniquePtr ModelInterface::createWorkspace() const
+{
+    auto ws = create_workspace_impl();
+
+    ws->_q.setZero(getNq());
+    ws->_v.setZero(getNv());
+    ws->_a.setZero(getNv());
+    ws->_tau.setZero(getNv());
+
+    updateWorkspace(*ws);
+
+    return ws;
+}
+
+void ModelInterface::updateWorkspace(Workspace& ws) const
+{
+    updateWorkspace(ws,
+                    getJointPosition(),
+                    getJointVelocity(),
+                    getJointAcceleration(),
+                    getJointEffort());
+}
+
+void ModelInterface::updateWorkspace(Workspace& ws, VecConstRef q) const
+{
+    check_and_set(q, ws._q, __func__);
+    ws._v.setZero();
+    ws._a.setZero();
+    ws._tau.setZero();
+
+    update_workspace_impl(ws);
+}
+
+void ModelInterface::updateWorkspace(Workspace& ws,
+                                     VecConstRef q,
+                                     VecConstRef v,
+                                     VecConstRef a,
+                                     VecConstRef tau) const
+{
+    check_and_set(q, ws._q, __func__);
+    check_and_set(v, ws._v, __func__);
+    check_and_set(a, ws._a, __func__);
+    check_and_set(tau, ws._tau, __func__);
+
+    update_workspace_impl(ws);
+}
+
+Eigen::Affine3d ModelInterface::getPose(Workspace&, int) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getJacobian(Workspace&, int, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+Eigen::Vector6d ModelInterface::getVelocityTwist(Workspace&, int) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+Eigen::Vector6d ModelInterface::getAccelerationTwist(Workspace&, int) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+Eigen::Vector6d ModelInterface::getJdotTimesV(Workspace&, int) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getJacobianTimeVariation(Workspace&, int, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+Eigen::Vector3d ModelInterface::getCOM(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getCOMJacobian(Workspace&, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+VecConstRef ModelInterface::computeInverseDynamics(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+VecConstRef ModelInterface::computeGravityCompensation(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+VecConstRef ModelInterface::computeNonlinearTerm(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+VecConstRef ModelInterface::computeForwardDynamics(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeInertiaInverseTimes(Workspace&, MatConstRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeInverseOperationalSpaceInertia(Workspace&, MatConstRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeInverseDynamicsDerivatives(Workspace&, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeForwardDynamicsDerivatives(Workspace&, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeCentroidalDynamicsDerivatives(Workspace&, MatRef, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeConstrainedDynamics(Workspace&, VecRef, VecRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeRegressor(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::computeImpulseDynamics(Workspace&, VecRef, VecRef, double) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getVelocityTwistDerivatives(Workspace&, int, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::getAccelerationTwistDerivatives(Workspace&, int, MatRef, MatRef, MatRef) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeInertiaMatrix(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeInertiaInverse(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeCentroidalMomentumMatrix(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+MatConstRef ModelInterface::computeCentroidalMomentumMatrixTimeVariation(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+ModelInterface::Workspace::UniquePtr ModelInterface::create_workspace_impl() const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::update_workspace_impl(Workspace&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+int ModelInterface::BatchData::getNumSamples() const
+{
+    return _n_samples;
+}
+
+void ModelInterface::BatchData::resize(const ModelInterface& model, int n_samples)
+{
+    if(n_samples < 0)
+    {
+        throw std::invalid_argument("number of samples must be non-negative");
+    }
+
+    _n_samples = n_samples;
+
+    const int nv = model.getNv();
+    const int nlinks = link_ids.size();
+
+    poses.resize((computation & Poses) ? nlinks*n_samples : 0);
+
+    jacobians.setZero((computation & Jacobians) ? 6*nlinks : 0,
+                      (computation & Jacobians) ? nv*n_samples : 0);
+
+    gcomp.setZero((computation & GravityCompensation) ? nv : 0,
+                  (computation & GravityCompensation) ? n_samples : 0);
+
+    inertia.setZero((computation & InertiaMatrix) ? nv : 0,
+                    (computation & InertiaMatrix) ? nv*n_samples : 0);
+
+    regressor.setZero((computation & Regressor) ? nv*n_samples : 0,
+                      (computation & Regressor) ? model.getDynamicParameters().size() : 0);
+}
+
+void ModelInterface::evaluateBatch(MatConstRef Q, BatchData& data, int n_threads) const
+{
+    if(data.computation & BatchData::Regressor)
+    {
+        throw std::invalid_argument(
+            fmt::format("{}: regressor computation requires velocities and accelerations",
+                        __func__)
+            );
+    }
+
+    evaluateBatch(Q, Eigen::MatrixXd(), Eigen::MatrixXd(), data, n_threads);
+}
+
+void ModelInterface::evaluateBatch(MatConstRef Q,
+                                   MatConstRef V,
+                                   MatConstRef A,
+                                   BatchData& data,
+                                   int n_threads) const
+{
+    const int n_samples = Q.cols();
+    const int nv = getNv();
+    const int nlinks = data.link_ids.size();
+
+    // check inputs and outputs
+    check_mat_size(Q, getNq(), n_samples, __func__);
+
+    if(data.getNumSamples() != n_samples)
+    {
+        throw std::out_of_range(
+            fmt::format("size mismatch in {}: batch data allocated for {} samples, {} given "
+                        "(call BatchData::resize)",
+                        __func__, data.getNumSamples(), n_samples)
+            );
+    }
+
+    if(data.computation & BatchData::Poses &&
+            data.poses.size() != size_t(nlinks*n_samples))
+    {
+        throw std::out_of_range(
+            fmt::format("size mismatch in {}: {} (actual) != {} (expected)",
+                        __func__, data.poses.size(), nlinks*n_samples)
+            );
+    }
+
+    if(data.computation & BatchData::Jacobians)
+    {
+        check_mat_size(data.jacobians, 6*nlinks, nv*n_samples, __func__);
+    }
+
+    if(data.computation & BatchData::GravityCompensation)
+    {
+        check_mat_size(data.gcomp, nv, n_samples, __func__);
+    }
+
+    if(data.computation & BatchData::InertiaMatrix)
+    {
+        check_mat_size(data.inertia, nv, nv*n_samples, __func__);
+    }
+
+    if(data.computation & BatchData::Regressor)
+    {
+        check_mat_size(V, nv, n_samples, __func__);
+        check_mat_size(A, nv, n_samples, __func__);
+        check_mat_size(data.regressor, nv*n_samples, getDynamicParameters().size(), __func__);
+    }
+
+    if(n_samples == 0)
+    {
+        return;
+    }
+
+    // note: plugin workspaces and workers are shared among calls
+    std::lock_guard batch_lock(impl->_batch_mtx);
+
+    // workers are persistent, and only re-created if the number
+    // of threads changes
+    n_threads = std::max(n_threads, 1);
+
+    if(!impl->_batch_pool || impl->_batch_pool->size() != n_threads)
+    {
+        impl->_batch_pool = std::make_unique<detail::ThreadPool>(n_threads);
+    }
+
+    init_batch_workers(n_threads);
+
+    // split samples into contiguous chunks (possibly empty)
+    const int chunk = n_samples / n_threads;
+    const int rem = n_samples % n_threads;
+
+    std::vector<std::exception_ptr> errors(n_threads);
+
+    auto run_worker = [&](int i)
+    {
+        int begin = i*chunk + std::min(i, rem);
+        int end = begin + chunk + (i < rem ? 1 : 0);
+
+        try
+        {
+            evaluate_batch_impl(Q, V, A, begin, end, i, data);
+        }
+        catch(...)
+        {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    impl->_batch_pool->run(run_worker);
+
+    for(auto& e : errors)
+    {
+        if(e)
+        {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+void ModelInterface::init_batch_workers(int) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void ModelInterface::evaluate_batch_impl(MatConstRef, MatConstRef, MatConstRef, int, int, int, BatchData&) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
 ModelInterface::~ModelInterface()
 {
 
@@ -733,6 +1221,12 @@ void XBotInterface::update()
 {
     impl->_tmp.setDirty();
     update_impl();
+    impl->_update_count++;
+}
+
+uint64_t XBotInterface::getUpdateCount() const
+{
+    return impl->_update_count;
 }
 
 string_const_ref XBotInterface::getLinkName(int id) const
@@ -1097,27 +1591,118 @@ void XBotInterface::getRelativeJacobian(int distal_id, int base_id, MatRef Jrel)
     // check mat size
     check_mat_size(Jrel, 6, getNv(), __func__);
 
-    // take Jrel from tmp
-    auto& Jtmp = impl->_tmp.J;
-    auto& Jtmp1 = impl->_tmp.J1;
+    // take jacobians from tmp
+    auto& Jb = impl->_tmp.J;
+    auto& Jd = impl->_tmp.J1;
 
-    // initialize Jrel with Jbase
-    getJacobian(base_id, Jtmp);
+    getJacobian(base_id, Jb);
+    getJacobian(distal_id, Jd);
 
-    // shift ref point to p_d
+    // Jrel = b_R_w * (Jd - Jb shifted to p_d)
     Eigen::Affine3d w_T_b = getPose(base_id);
     Eigen::Affine3d w_T_d = getPose(distal_id);
     Eigen::Vector3d r = w_T_d.translation() - w_T_b.translation();
-    Utils::changeRefPoint(Jtmp, r);
+    Eigen::Matrix3d S = Utils::skew(r);
+    Eigen::Matrix3d b_R_w = w_T_b.linear().transpose();
 
-    // get distal jacobian
-    getJacobian(distal_id, Jrel);
+    auto process_column = [&](int i)
+    {
+        Eigen::Vector6d Ji = Jd.col(i) - Jb.col(i);
+        Ji.head<3>().noalias() += S * Jb.col(i).tail<3>();
+        Jrel.col(i).head<3>().noalias() = b_R_w * Ji.head<3>();
+        Jrel.col(i).tail<3>().noalias() = b_R_w * Ji.tail<3>();
+    };
 
-    // now Jrel = Jd - Jb_shifted
-    Jtmp1 = Jrel - Jtmp;
+    // only columns inside the union of the two supports can be non-zero
+    const auto& sb = getJacobianSupport(base_id);
+    const auto& sd = getJacobianSupport(distal_id);
 
-    // rotate to base
-    Utils::rotate(Jtmp1, w_T_b.linear().transpose(), Jrel);
+    Jrel.setZero();
+
+    auto itb = sb.begin();
+    auto itd = sd.begin();
+
+    while(itb != sb.end() || itd != sd.end())
+    {
+        if(itd == sd.end() || (itb != sb.end() && *itb < *itd))
+        {
+            process_column(*itb++);
+        }
+        else if(itb == sb.end() || *itd < *itb)
+        {
+            process_column(*itd++);
+        }
+        else
+        {
+            process_column(*itb);
+            ++itb;
+            ++itd;
+        }
+    }
+}
+
+const std::vector<int>& XBotInterface::getJacobianSupport(int link_id) const
+{
+    auto it = impl->_link_support.find(link_id);
+
+    if(it == impl->_link_support.end())
+    {
+        return impl->_full_support;
+    }
+
+    return it->second;
+}
+
+const std::vector<int>& XBotInterface::getJacobianSupport(string_const_ref link_name) const
+{
+    return getJacobianSupport(impl->get_link_id_throw(link_name));
+}
+
+void XBotInterface::getJacobianCompact(int link_id, MatRef Jc) const
+{
+    const auto& support = getJacobianSupport(link_id);
+
+    check_mat_size(Jc, 6, support.size(), __func__);
+
+    // note: the full jacobian is computed, then gathered
+    auto& J = impl->_tmp.J;
+
+    getJacobian(link_id, J);
+
+    for(int i = 0; i < Jc.cols(); i++)
+    {
+        Jc.col(i) = J.col(support[i]);
+    }
+}
+
+void XBotInterface::getJacobianTimeVariation(int link_id, MatRef dJ) const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+bool XBotInterface::getJacobianTimeVariation(string_const_ref link_name, MatRef dJ) const
+{
+    int idx = impl->get_link_id_error(link_name);
+
+    if(idx < 0)
+    {
+        return false;
+    }
+
+    getJacobianTimeVariation(idx, dJ);
+
+    return true;
+}
+
+Eigen::MatrixXd XBotInterface::getJacobianTimeVariation(string_const_ref link_name) const
+{
+    Eigen::MatrixXd dJ;
+
+    dJ.setZero(6, getNv());
+
+    getJacobianTimeVariation(impl->get_link_id_throw(link_name), dJ);
+
+    return dJ;
 }
 
 bool XBotInterface::getRelativeJacobian(string_const_ref distal_name,
@@ -1549,6 +2134,23 @@ Eigen::Vector6d XBotInterface::computeCentroidalMomentum() const
     return ret;
 }
 
+MatConstRef XBotInterface::computeCentroidalMomentumMatrixTimeVariation() const
+{
+    throw NotImplemented(__PRETTY_FUNCTION__);
+}
+
+void XBotInterface::computeCentroidalMomentumMatrixTimeVariation(Eigen::MatrixXd &dAg) const
+{
+    dAg = computeCentroidalMomentumMatrixTimeVariation();
+}
+
+Eigen::Vector6d XBotInterface::computeCentroidalMomentumMatrixDotTimesV() const
+{
+    Eigen::Vector6d ret;
+    ret.noalias() = computeCentroidalMomentumMatrixTimeVariation() * getJointVelocity();
+    return ret;
+}
+
 void XBotInterface::computeForwardDynamics(Eigen::VectorXd &fd) const
 {
     fd = computeForwardDynamics();
@@ -1564,6 +2166,56 @@ void XBotInterface::computeInertiaInverse(Eigen::MatrixXd &Minv) const
     Minv = computeInertiaInverse();
 }
 
+void XBotInterface::computeInertiaInverseTimes(MatConstRef B, MatRef MinvB) const
+{
+    check_mat_size(MinvB, getNv(), B.cols(), __func__);
+
+    MinvB = impl->get_inertia_ldlt().solve(B);
+}
+
+void XBotInterface::computeInverseOperationalSpaceInertia(MatConstRef J, MatRef Linv) const
+{
+    check_mat_size(Linv, J.rows(), J.rows(), __func__);
+
+    Linv.noalias() = J * impl->get_inertia_ldlt().solve(J.transpose());
+}
+
+void XBotInterface::computeOperationalSpaceInertia(const std::vector<int>& link_ids,
+                                                   MatRef Lambda) const
+{
+    check_mat_size(Lambda, 6*link_ids.size(), 6*link_ids.size(), __func__);
+
+    Lambda = impl->compute_operational_space_inertia(link_ids).Lambda;
+}
+
+void XBotInterface::computeOperationalSpaceInertia(int link_id, MatRef Lambda) const
+{
+    impl->_tmp.osi_single_link[0] = link_id;
+
+    computeOperationalSpaceInertia(impl->_tmp.osi_single_link, Lambda);
+}
+
+void XBotInterface::computeDynamicallyConsistentInverse(const std::vector<int>& link_ids,
+                                                        MatRef Jbar) const
+{
+    check_mat_size(Jbar, getNv(), 6*link_ids.size(), __func__);
+
+    auto& osi = impl->compute_operational_space_inertia(link_ids);
+
+    if(osi.jbar_dirty)
+    {
+        // Jbar = M^-1 * J^T * Lambda (note: resize is a no-op
+        // unless the link set has changed)
+        osi.MinvJt.resize(getNv(), osi.J.rows());
+        osi.Jbar.resize(getNv(), osi.J.rows());
+        computeInertiaInverseTimes(osi.J.transpose(), osi.MinvJt);
+        osi.Jbar.noalias() = osi.MinvJt * osi.Lambda;
+        osi.jbar_dirty = false;
+    }
+
+    Jbar = osi.Jbar;
+}
+
 Eigen::VectorXd XBotInterface::sum(VecConstRef q0, VecConstRef v) const
 {
     Eigen::VectorXd q1;
@@ -1717,6 +2369,83 @@ int XBotInterface::Impl::get_link_id_error(string_const_ref link_name) const
     return idx;
 }
 
+const Eigen::LDLT<Eigen::MatrixXd>& XBotInterface::Impl::get_inertia_ldlt()
+{
+    if(_tmp.ldlt_dirty)
+    {
+        _tmp.M = _api->computeInertiaMatrix();
+        _tmp.ldlt.compute(_tmp.M);
+        _tmp.ldlt_dirty = false;
+    }
+
+    return _tmp.ldlt;
+}
+
+XBotInterface::Impl::OsiCache&
+XBotInterface::Impl::compute_operational_space_inertia(const std::vector<int>& link_ids)
+{
+    // look for the given link set, otherwise replace the
+    // least recently used entry
+    auto * osi = &_tmp.osi_cache[0];
+
+    for(auto& c : _tmp.osi_cache)
+    {
+        if(c.link_ids == link_ids)
+        {
+            osi = &c;
+            break;
+        }
+
+        if(c.last_used < osi->last_used)
+        {
+            osi = &c;
+        }
+    }
+
+    osi->last_used = ++_tmp.osi_clock;
+
+    if(!osi->dirty && osi->link_ids == link_ids)
+    {
+        return *osi;
+    }
+
+    const int nv = _api->getNv();
+    const int m = 6*link_ids.size();
+
+    osi->dirty = true;
+    osi->link_ids = link_ids;
+    osi->J.resize(m, nv);
+    osi->Linv.resize(m, m);
+
+    for(int k = 0; k < link_ids.size(); k++)
+    {
+        _api->getJacobian(link_ids[k], osi->J.middleRows<6>(6*k));
+    }
+
+    // J * M^-1 * J^T, backends can exploit the structure of M
+    _api->computeInverseOperationalSpaceInertia(osi->J, osi->Linv);
+
+    // J * M^-1 * J^T is only invertible if J has full row rank
+    osi->ldlt.compute(osi->Linv);
+
+    if(osi->ldlt.info() != Eigen::Success ||
+        !osi->ldlt.isPositive() ||
+        osi->ldlt.rcond() < 1e-12)
+    {
+        throw std::runtime_error(
+            fmt::format("operational space inertia is singular (rcond = {}): the stacked "
+                        "jacobian of the given links must have full row rank",
+                        osi->ldlt.rcond()));
+    }
+
+    osi->Lambda = osi->ldlt.solve(Eigen::MatrixXd::Identity(m, m));
+
+    osi->dirty = false;
+    osi->jbar_dirty = true;
+
+    return *osi;
+}
+
 int XBotInterface::Impl::get_link_id_throw(string_const_ref link_name) const
 {
     int idx = _api->getLinkId(link_name);
@@ -2020,8 +2749,36 @@ void XBotInterface::Impl::finalize()
         }
 
         _link_id_to_name[id] = lname;
+
+        // jacobian support: velocity indices of all joints
+        // from the root to this link
+        auto& support = _link_support[id];
+
+        for(auto jptr = lptr->parent_joint;
+            jptr;
+            jptr = _urdf->getLink(jptr->parent_link_name)->parent_joint)
+        {
+            auto jit = _name_id_map.find(jptr->name);
+
+            if(jit == _name_id_map.end())
+            {
+                continue;
+            }
+
+            const auto& jinfo = _joint_info[jit->second];
+
+            for(int i = 0; i < jinfo.nv; i++)
+            {
+                support.push_back(jinfo.iv + i);
+            }
+        }
+
+        std::sort(support.begin(), support.end());
     }
 
+    _full_support.resize(nv);
+    std::iota(_full_support.begin(), _full_support.end(), 0);
+
     // resize temporaries
     _tmp.setZero(nq, nv);
 
@@ -2203,11 +2960,17 @@ void XBotInterface::Impl::Temporaries::setZero(int nq, int nv)
     q.setZero(nq);
     M.setIdentity(nv, nv);
     ldlt.compute(M);
+    osi_single_link.resize(1);
 }
 
 void XBotInterface::Impl::Temporaries::setDirty()
 {
     ldlt_dirty = true;
+
+    for(auto& c : osi_cache)
+    {
+        c.dirty = true;
+    }
 }
 
 bool XBotInterface::ConfigOptions::set_urdf(std::string urdf_string)
@@ -5,6 +5,7 @@
 
 
 #include <chrono>
+#include <utility>
 
 #include <gtest/gtest.h>
 
@@ -20,6 +21,60 @@ srdf_path = XBOT2_TEST_RESOURCE_DIR "centauro_capsule.srdf";
 #define TIC(name) auto tic_##name = std::chrono::high_resolution_clock::now()
 #define TOC(name) std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tic_##name).count()
 
+/**
+ * @brief centralDifferences approximates the partial derivatives of f
+ * w.r.t. q and v at the state of model; f is evaluated on model_fd, whose
+ * state is set to (q + dq, v + dv) and to the acceleration and effort
+ * of model, and then updated
+ * @param f: callable returning the (stacked) quantities to be differentiated
+ * as an Eigen::VectorXd, given a const ModelInterface&
+ * @param df_dq, df_dv (output) numerical derivatives
+ */
+template <typename F>
+void centralDifferences(const XBot::ModelInterface& model,
+                        XBot::ModelInterface& model_fd,
+                        F&& f,
+                        Eigen::MatrixXd& df_dq,
+                        Eigen::MatrixXd& df_dv,
+                        double h = 1e-6)
+{
+    const int nv = model.getNv();
+
+    Eigen::VectorXd q = model.getJointPosition();
+    Eigen::VectorXd v = model.getJointVelocity();
+
+    auto eval = [&](const Eigen::VectorXd& qi, const Eigen::VectorXd& vi) -> Eigen::VectorXd
+    {
+        model_fd.setJointPosition(qi);
+        model_fd.setJointVelocity(vi);
+        model_fd.setJointAcceleration(model.getJointAcceleration());
+        model_fd.setJointEffort(model.getJointEffort());
+        model_fd.update();
+        return f(std::as_const(model_fd));
+    };
+
+    Eigen::VectorXd qp, qm;
+
+    for(int k = 0; k < nv; k++)
+    {
+        Eigen::VectorXd dv = Eigen::VectorXd::Unit(nv, k)*h;
+
+        model.sum(q, dv, qp);
+        model.sum(q, -dv, qm);
+
+        Eigen::VectorXd dfk = (eval(qp, v) - eval(qm, v))/(2*h);
+
+        if(k == 0)
+        {
+            df_dq.resize(dfk.size(), nv);
+            df_dv.resize(dfk.size(), nv);
+        }
+
+        df_dq.col(k) = dfk;
+        df_dv.col(k) = (eval(q, v + dv) - eval(q, v - dv))/(2*h);
+    }
+}
+
 
 
 class TestCommon : public testing::Test
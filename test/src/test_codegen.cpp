@@ -0,0 +1,303 @@
+#include "common.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+class TestCodegen : public TestWithModel
+{
+
+protected:
+
+    XBot::ModelInterface::Ptr model_cg;
+
+    void SetUp() override
+    {
+        TestWithModel::SetUp();
+
+        model_cg = XBot::ModelInterface::getModel(urdf, srdf, "pin_cg");
+    }
+
+    void setRandomState(Eigen::VectorXd& tau)
+    {
+        const int nv = model->getNv();
+
+        Eigen::VectorXd q = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+        tau = Eigen::VectorXd::Random(nv);
+
+        for(auto m : {model, model_cg})
+        {
+            m->setJointPosition(q);
+            m->setJointVelocity(v);
+            m->setJointAcceleration(a);
+            m->setJointEffort(tau);
+            m->update();
+        }
+    }
+
+};
+
+TEST_F(TestCodegen, checkDynamics)
+{
+    ASSERT_EQ(model_cg->getComputationStatistics().at("codegen_enabled"), 1);
+
+    Eigen::VectorXd tau;
+
+    for(int i = 0; i < 100; i++)
+    {
+        setRandomState(tau);
+
+        Eigen::VectorXd rnea = model->computeInverseDynamics();
+        Eigen::VectorXd rnea_cg = model_cg->computeInverseDynamics();
+
+        EXPECT_TRUE(rnea_cg.isApprox(rnea, 1e-9)) <<
+            "rnea    = " << rnea.transpose().format(3) << "\n" <<
+            "rnea_cg = " << rnea_cg.transpose().format(3) << "\n";
+
+        Eigen::MatrixXd M = model->computeInertiaMatrix();
+        Eigen::MatrixXd M_cg = model_cg->computeInertiaMatrix();
+
+        EXPECT_TRUE(M_cg.isApprox(M, 1e-9)) <<
+            "M    = \n" << M.format(3) << "\n" <<
+            "M_cg = \n" << M_cg.format(3) << "\n";
+
+        Eigen::VectorXd aba = model->computeForwardDynamics();
+        Eigen::VectorXd aba_cg = model_cg->computeForwardDynamics();
+
+        EXPECT_TRUE(aba_cg.isApprox(aba, 1e-6)) <<
+            "aba    = " << aba.transpose().format(3) << "\n" <<
+            "aba_cg = " << aba_cg.transpose().format(3) << "\n";
+    }
+}
+
+TEST_F(TestCodegen, checkKinematics)
+{
+    std::vector<std::string> hot_links = {"arm1_7", "arm2_7", "pelvis"};
+
+    ASSERT_TRUE(model_cg->setHotLinks(hot_links));
+
+    const int nv = model->getNv();
+
+    Eigen::MatrixXd J(6, nv), J_cg(6, nv);
+
+    Eigen::VectorXd tau;
+
+    for(int i = 0; i < 100; i++)
+    {
+        setRandomState(tau);
+
+        model_cg->resetComputationStatistics();
+
+        for(auto lname : hot_links)
+        {
+            int id = model->getLinkId(lname);
+
+            Eigen::Affine3d T = model->getPose(id);
+            Eigen::Affine3d T_cg = model_cg->getPose(id);
+
+            EXPECT_TRUE(T_cg.isApprox(T, 1e-9)) << lname;
+
+            model->getJacobian(id, J);
+            model_cg->getJacobian(id, J_cg);
+
+            EXPECT_TRUE(J_cg.isApprox(J, 1e-9)) << lname <<
+                "\nJ    = \n" << J.format(3) << "\n" <<
+                "J_cg = \n" << J_cg.format(3) << "\n";
+        }
+
+        // pose and jacobian are generated together, i.e. evaluated
+        // once per hot link
+        auto stats = model_cg->getComputationStatistics();
+        EXPECT_EQ(stats.at("codegen_kinematics_miss"), hot_links.size());
+        EXPECT_EQ(stats.at("codegen_kinematics_hit"), hot_links.size());
+
+        // other links run the generic algorithms
+        EXPECT_TRUE(model_cg->getPose("arm1_3").isApprox(model->getPose("arm1_3")));
+    }
+
+    Eigen::MatrixXd J_wrong(6, nv + 1);
+    EXPECT_THROW(model_cg->getJacobian(model->getLinkId("arm1_7"), J_wrong),
+                 std::out_of_range);
+}
+
+TEST_F(TestCodegen, checkCorruptedCache)
+{
+    auto cache_dir = std::filesystem::temp_directory_path() /
+                     ("xbot2ifc_codegen_test_" + std::to_string(getpid()));
+
+    auto opt = model_cg->getConfigOptions();
+    opt.set_parameter("codegen_cache_dir", cache_dir.string());
+
+    // populate the cache
+    XBot::ModelInterface::getModel(opt);
+
+    // simulate a crashed build by truncating the cached libraries
+    int n_libs = 0;
+
+    for(const auto& entry : std::filesystem::directory_iterator(cache_dir))
+    {
+        std::ofstream(entry.path(), std::ios::trunc) << "corrupted";
+        n_libs++;
+    }
+
+    EXPECT_GT(n_libs, 0);
+
+    // libraries that fail to load are regenerated
+    model_cg = XBot::ModelInterface::getModel(opt);
+
+    ASSERT_EQ(model_cg->getComputationStatistics().at("codegen_enabled"), 1);
+
+    Eigen::VectorXd tau;
+
+    setRandomState(tau);
+
+    EXPECT_TRUE(model_cg->computeInverseDynamics().isApprox(
+        model->computeInverseDynamics(), 1e-9));
+
+    EXPECT_TRUE(model_cg->computeInertiaMatrix().isApprox(
+        model->computeInertiaMatrix(), 1e-9));
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+TEST_F(TestCodegen, checkForwardDynamicsCache)
+{
+    Eigen::VectorXd tau;
+
+    setRandomState(tau);
+
+    model_cg->resetComputationStatistics();
+
+    // generated forward dynamics share the effort-keyed cache
+    Eigen::VectorXd ddq = model_cg->computeForwardDynamics();
+    model_cg->computeForwardDynamics();
+
+    auto stats = model_cg->getComputationStatistics();
+    EXPECT_EQ(stats.at("forward_dynamics_miss"), 1);
+    EXPECT_EQ(stats.at("forward_dynamics_hit"), 1);
+
+    // a new effort is a cache miss
+    model_cg->setJointEffort(-tau);
+    model->setJointEffort(-tau);
+
+    EXPECT_TRUE(model_cg->computeForwardDynamics().isApprox(
+        model->computeForwardDynamics(), 1e-6));
+
+    EXPECT_EQ(model_cg->getComputationStatistics().at("forward_dynamics_miss"), 2);
+
+    // the same holds for inverse dynamics and the inertia matrix
+    model_cg->computeInverseDynamics();
+    model_cg->computeInverseDynamics();
+    model_cg->computeInertiaMatrix();
+    model_cg->computeInertiaMatrix();
+
+    stats = model_cg->getComputationStatistics();
+    EXPECT_EQ(stats.at("rnea_miss"), 1);
+    EXPECT_EQ(stats.at("rnea_hit"), 1);
+    EXPECT_EQ(stats.at("crba_miss"), 1);
+    EXPECT_EQ(stats.at("crba_hit"), 1);
+}
+
+TEST_F(TestCodegen, checkTiming)
+{
+    const int iter = 1000;
+
+    Eigen::VectorXd tau;
+
+    double dt_rnea = 0, dt_rnea_cg = 0;
+    double dt_crba = 0, dt_crba_cg = 0;
+    double dt_aba = 0, dt_aba_cg = 0;
+
+    for(int i = 0; i < iter; i++)
+    {
+        // update() invalidates any cached result
+        setRandomState(tau);
+
+        {
+            TIC();
+            model->computeInverseDynamics();
+            dt_rnea += TOC();
+        }
+
+        {
+            TIC();
+            model_cg->computeInverseDynamics();
+            dt_rnea_cg += TOC();
+        }
+
+        {
+            TIC();
+            model->computeInertiaMatrix();
+            dt_crba += TOC();
+        }
+
+        {
+            TIC();
+            model_cg->computeInertiaMatrix();
+            dt_crba_cg += TOC();
+        }
+
+        {
+            TIC();
+            model->computeForwardDynamics();
+            dt_aba += TOC();
+        }
+
+        {
+            TIC();
+            model_cg->computeForwardDynamics();
+            dt_aba_cg += TOC();
+        }
+    }
+
+    std::cout << "rnea requires " << dt_rnea/iter*1e6 << " us (pin), " <<
+        dt_rnea_cg/iter*1e6 << " us (pin_cg) \n";
+
+    std::cout << "crba requires " << dt_crba/iter*1e6 << " us (pin), " <<
+        dt_crba_cg/iter*1e6 << " us (pin_cg) \n";
+
+    std::cout << "aba requires " << dt_aba/iter*1e6 << " us (pin), " <<
+        dt_aba_cg/iter*1e6 << " us (pin_cg) \n";
+}
+
+TEST_F(TestCodegen, checkFallback)
+{
+    model_cg->addFixedLink("cg_test_link",
+                           "pelvis",
+                           1.0,
+                           Eigen::Matrix3d::Identity(),
+                           Eigen::Affine3d::Identity());
+
+    model->addFixedLink("cg_test_link",
+                        "pelvis",
+                        1.0,
+                        Eigen::Matrix3d::Identity(),
+                        Eigen::Affine3d::Identity());
+
+    EXPECT_EQ(model_cg->getComputationStatistics().at("codegen_enabled"), 0);
+
+    // fallback results must account for the added link
+    Eigen::VectorXd tau;
+
+    setRandomState(tau);
+
+    EXPECT_TRUE(model_cg->computeInverseDynamics().isApprox(
+        model->computeInverseDynamics()));
+
+    EXPECT_TRUE(model_cg->computeInertiaMatrix().isApprox(
+        model->computeInertiaMatrix()));
+
+    EXPECT_TRUE(model_cg->computeForwardDynamics().isApprox(
+        model->computeForwardDynamics()));
+}
+
+
+int main(int argc, char ** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
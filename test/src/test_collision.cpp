@@ -3,6 +3,8 @@
 #include <xbot2_interface/collision.h>
 #include <fmt/format.h>
 
+#include <set>
+
 struct TestCollision : TestWithModel
 {
     std::shared_ptr<XBot::Collision::CollisionModel> cm;
@@ -562,6 +564,424 @@ TEST_F(TestCollision, checkJacobian)
 
 }
 
+TEST_F(TestCollision, checkBroadphaseThreshold)
+{
+    // populate the environment with a grid of boxes
+    XBot::Collision::Shape::Box box;
+    box.size << 0.2, 0.2, 0.2;
+
+    for(int i = 0; i < 5; i++)
+    {
+        for(int j = 0; j < 5; j++)
+        {
+            Eigen::Affine3d w_T_c;
+            w_T_c.setIdentity();
+            w_T_c.translation() << -1.0 + 0.5*i, -1.0 + 0.5*j, 0.5;
+
+            cm->addCollisionShape(fmt::format("box_{}_{}", i, j), "world", box, w_T_c);
+        }
+    }
+
+    double th = 0.10;
+
+    for(int k = 0; k < 100; k++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+        cm->update();
+
+        for(bool include_env : {false, true})
+        {
+            Eigen::VectorXd d_exact = cm->computeDistance(include_env);
+            Eigen::VectorXd d = cm->computeDistance(include_env, th);
+
+            ASSERT_EQ(d.size(), d_exact.size());
+
+            for(int i = 0; i < d.size(); i++)
+            {
+                // pairs under the threshold must not be culled
+                if(d_exact[i] < th)
+                {
+                    EXPECT_NEAR(d[i], d_exact[i], 1e-6) << "pair " << i;
+                }
+                else if(std::isfinite(d[i]))
+                {
+                    // pairs whose aabbs are within the threshold
+                    // get the exact distance
+                    EXPECT_NEAR(d[i], d_exact[i], 1e-6) << "pair " << i;
+                }
+            }
+
+            // all other pairs have zero normal and witness points
+            auto n = cm->getNormals(include_env);
+            auto wp = cm->getWitnessPoints(include_env);
+
+            for(int i = 0; i < d.size(); i++)
+            {
+                if(!std::isfinite(d[i]))
+                {
+                    EXPECT_TRUE(n[i].isZero()) << "pair " << i;
+                    EXPECT_TRUE(wp[i].first.isZero() && wp[i].second.isZero()) << "pair " << i;
+                }
+            }
+
+            // collision check must agree with the exact distance
+            std::vector<int> coll_ids;
+            cm->checkCollision(coll_ids, include_env);
+
+            for(int i = 0; i < d.size(); i++)
+            {
+                if(std::fabs(d_exact[i]) < 1e-3)
+                {
+                    continue;
+                }
+
+                bool found = std::find(coll_ids.begin(), coll_ids.end(), i) != coll_ids.end();
+                EXPECT_EQ(found, d_exact[i] < 0) << "pair " << i;
+            }
+        }
+    }
+}
+
+TEST_F(TestCollision, checkBroadphaseLargeEnvironment)
+{
+    // populate a large environment with boxes, most of them far
+    // from the robot
+    XBot::Collision::Shape::Box box;
+    box.size << 0.2, 0.2, 0.2;
+
+    for(int i = 0; i < 15; i++)
+    {
+        for(int j = 0; j < 15; j++)
+        {
+            Eigen::Affine3d w_T_c;
+            w_T_c.setIdentity();
+            w_T_c.translation() << -7.0 + 1.0*i, -7.0 + 1.0*j, 0.5;
+
+            cm->addCollisionShape(fmt::format("box_{}_{}", i, j), "world", box, w_T_c);
+        }
+    }
+
+    const int n_pairs = cm->getNumCollisionPairs(true);
+
+    double th = 0.05;
+
+    double dt_full = 0, dt_bp = 0;
+
+    uint64_t evals_full = 0, evals_bp = 0;
+
+    for(int k = 0; k < 10; k++)
+    {
+        model->setJointPosition(model->getRobotState("home"));
+        model->update();
+        cm->update();
+
+        cm->resetComputationStatistics();
+
+        TIC(full);
+        Eigen::VectorXd d_exact = cm->computeDistance(true);
+        dt_full += TOC(full);
+
+        evals_full += cm->getComputationStatistics().at("distance_pair_evaluations");
+
+        cm->resetComputationStatistics();
+
+        TIC(bp);
+        Eigen::VectorXd d = cm->computeDistance(true, th);
+        dt_bp += TOC(bp);
+
+        evals_bp += cm->getComputationStatistics().at("distance_pair_evaluations");
+
+        for(int i = 0; i < n_pairs; i++)
+        {
+            if(d_exact[i] < th)
+            {
+                EXPECT_NEAR(d[i], d_exact[i], 1e-6) << "pair " << i;
+            }
+        }
+    }
+
+    // without threshold all pairs are evaluated, whereas the broadphase
+    // must not even visit pairs that are far apart
+    EXPECT_EQ(evals_full, 10*n_pairs);
+    EXPECT_LT(evals_bp, evals_full/10);
+
+    std::cout << n_pairs << " pairs, " << evals_bp/10 << " evaluated with broadphase \n";
+    std::cout << "computeDistance requires " << dt_full/10*1e6 << " us (no threshold), " <<
+        dt_bp/10*1e6 << " us (broadphase) \n";
+}
+
+TEST_F(TestCollision, checkParallelDistance)
+{
+    EXPECT_EQ(cm->getNumThreads(), 1);
+
+    EXPECT_THROW(cm->setNumThreads(0), std::invalid_argument);
+    EXPECT_THROW(cm->setNumThreads(4, {0, 1}), std::invalid_argument);
+    EXPECT_THROW(cm->setNumThreads(2, {-1}), std::invalid_argument);
+    EXPECT_THROW(cm->setNumThreads(2, {1 << 20}), std::invalid_argument);
+    EXPECT_EQ(cm->getNumThreads(), 1);
+
+    auto cm_par = std::make_shared<XBot::Collision::CollisionModel>(model);
+    cm_par->setNumThreads(4);
+    EXPECT_EQ(cm_par->getNumThreads(), 4);
+
+    double dt_seq = 0, dt_par = 0;
+
+    int count = 1000;
+
+    for(int k = 0; k < count; k++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+        cm->update();
+        cm_par->update();
+
+        TIC(seq);
+        Eigen::VectorXd d_seq = cm->computeDistance(true);
+        dt_seq += TOC(seq);
+
+        TIC(par);
+        Eigen::VectorXd d_par = cm_par->computeDistance(true);
+        dt_par += TOC(par);
+
+        // output ordering does not depend on the number of threads
+        ASSERT_EQ(d_seq.size(), d_par.size());
+        EXPECT_LT((d_seq - d_par).lpNorm<Eigen::Infinity>(), 1e-6);
+
+        auto wp_seq = cm->getWitnessPoints(true);
+        auto wp_par = cm_par->getWitnessPoints(true);
+
+        for(int i = 0; i < wp_seq.size(); i++)
+        {
+            EXPECT_LT((wp_seq[i].first - wp_par[i].first).norm(), 1e-6);
+            EXPECT_LT((wp_seq[i].second - wp_par[i].second).norm(), 1e-6);
+        }
+    }
+
+    std::cout << "CollisionModel::getDistance (1 thread) requires " << dt_seq/count*1e6 << " us \n";
+    std::cout << "CollisionModel::getDistance (4 threads) requires " << dt_par/count*1e6 << " us \n";
+}
+
+TEST_F(TestCollision, checkGjkWarmStart)
+{
+    EXPECT_TRUE(cm->getGjkWarmStart());
+
+    auto cm_cold = std::make_shared<XBot::Collision::CollisionModel>(model);
+    cm_cold->setGjkWarmStart(false);
+    EXPECT_FALSE(cm_cold->getGjkWarmStart());
+
+    double dt_warm = 0, dt_cold = 0;
+
+    int count = 0;
+
+    cm->resetComputationStatistics();
+    cm_cold->resetComputationStatistics();
+
+    // smooth trajectories sampled at 1 kHz
+    for(int k = 0; k < 10; k++)
+    {
+        Eigen::VectorXd q0 = model->generateRandomQ();
+        Eigen::VectorXd dq = model->difference(model->generateRandomQ(), q0);
+
+        for(double t = 0; t < 1.0; t += 0.001)
+        {
+            model->setJointPosition(model->sum(q0, dq*0.5*(1 - std::cos(M_PI*t))));
+            model->update();
+            cm->update();
+            cm_cold->update();
+
+            TIC(warm);
+            Eigen::VectorXd d_warm = cm->computeDistance(true);
+            dt_warm += TOC(warm);
+
+            TIC(cold);
+            Eigen::VectorXd d_cold = cm_cold->computeDistance(true);
+            dt_cold += TOC(cold);
+
+            count++;
+
+            // warm start must not change the result of separated pairs
+            for(int i = 0; i < d_warm.size(); i++)
+            {
+                if(d_cold[i] > 0)
+                {
+                    EXPECT_NEAR(d_warm[i], d_cold[i], 1e-4) << "pair " << i;
+                }
+            }
+        }
+    }
+
+    std::cout << "CollisionModel::getDistance (cold start) requires " << dt_cold/count*1e6 << " us \n";
+    std::cout << "CollisionModel::getDistance (warm start) requires " << dt_warm/count*1e6 << " us \n";
+
+    auto stats_warm = cm->getComputationStatistics();
+    auto stats_cold = cm_cold->getComputationStatistics();
+
+    // both models run the narrowphase on the same pairs
+    EXPECT_GT(stats_cold["gjk_evaluations"], 0);
+    EXPECT_EQ(stats_warm["gjk_evaluations"], stats_cold["gjk_evaluations"]);
+
+    if(!stats_cold.contains("gjk_iterations"))
+    {
+        GTEST_SKIP() << "GJK iterations are not available with this hpp-fcl version";
+    }
+
+    double it_warm = stats_warm["gjk_iterations"]/std::max(1.0, double(stats_warm["gjk_evaluations"]));
+    double it_cold = stats_cold["gjk_iterations"]/std::max(1.0, double(stats_cold["gjk_evaluations"]));
+
+    std::cout << "GJK (cold start) requires " << it_cold << " iterations per pair \n";
+    std::cout << "GJK (warm start) requires " << it_warm << " iterations per pair \n";
+
+    // on a smooth trajectory the previous separating direction is a good guess
+    EXPECT_LE(stats_warm["gjk_iterations"], stats_cold["gjk_iterations"]);
+}
+
+TEST_F(TestCollision, checkDistanceJacobianThreshold)
+{
+    double th = 0.05;
+
+    const auto& pairs = cm->getCollisionPairs(false);
+
+    for(int k = 0; k < 100; k++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+        cm->update();
+
+        Eigen::VectorXd d_full = cm->computeDistance();
+        Eigen::MatrixXd J_full = cm->getDistanceJacobian();
+
+        // note: this invalidates all link jacobians
+        cm->update();
+
+        Eigen::VectorXd d = cm->computeDistance(false, th);
+
+        cm->resetComputationStatistics();
+        Eigen::MatrixXd J = cm->getDistanceJacobian();
+
+        std::set<std::string> active_links;
+
+        for(int i = 0; i < d.size(); i++)
+        {
+            // rows of culled pairs and pairs above the threshold are zero
+            if(!std::isfinite(d[i]) || d[i] > th)
+            {
+                EXPECT_EQ(J.row(i).lpNorm<Eigen::Infinity>(), 0) << "pair " << i;
+                continue;
+            }
+
+            active_links.insert(pairs[i].first);
+            active_links.insert(pairs[i].second);
+
+            // the other ones must match the ones computed without threshold
+            // (penetrating pairs are skipped)
+            if(d_full[i] > 1e-3)
+            {
+                EXPECT_LT((J.row(i) - J_full.row(i)).lpNorm<Eigen::Infinity>(), 1e-4) << "pair " << i;
+            }
+        }
+
+        // link jacobians are only computed for links inside active pairs
+        EXPECT_EQ(cm->getComputationStatistics().at("link_jacobian_evaluations"),
+                  active_links.size());
+    }
+}
+
+TEST_F(TestCollision, checkDistanceJacobianModelChanged)
+{
+    std::vector<int> active_idx;
+    Eigen::MatrixXd J;
+
+    Eigen::VectorXd q0 = model->generateRandomQ();
+
+    model->setJointPosition(q0);
+    model->update();
+    cm->update();
+    cm->computeDistance();
+
+    // setting the next configuration without updating the model is fine
+    model->setJointPosition(model->generateRandomQ());
+
+    EXPECT_NO_THROW(cm->getDistanceJacobian());
+
+    // link jacobians are computed on demand, hence the model must
+    // not be updated
+    model->setJointPosition(q0);
+    model->update();
+
+    EXPECT_THROW(cm->getDistanceJacobian(), std::runtime_error);
+    EXPECT_THROW(cm->getActiveDistanceJacobian(0.05, active_idx, J), std::runtime_error);
+
+    cm->update();
+    cm->computeDistance();
+
+    EXPECT_NO_THROW(cm->getDistanceJacobian());
+
+    // the collision model is updated with the kinematics at q0, while the
+    // joint position was already set to q1; updating the model afterwards
+    // would mix witness points at q0 with link jacobians at q1
+    model->setJointPosition(model->generateRandomQ());
+    cm->update();
+    cm->computeDistance();
+    model->update();
+
+    EXPECT_THROW(cm->getDistanceJacobian(), std::runtime_error);
+}
+
+TEST_F(TestCollision, checkActiveDistanceJacobian)
+{
+    double th = 0.05;
+
+    for(int k = 0; k < 100; k++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+        cm->update();
+
+        Eigen::VectorXd d = cm->computeDistance();
+        Eigen::MatrixXd J_full = cm->getDistanceJacobian();
+
+        std::vector<int> active_idx, active_cols;
+        Eigen::MatrixXd J, J_compact;
+
+        cm->getActiveDistanceJacobian(th, active_idx, J);
+        cm->getActiveDistanceJacobian(th, active_idx, active_cols, J_compact);
+
+        ASSERT_EQ(J.rows(), active_idx.size());
+        ASSERT_EQ(J.cols(), model->getNv());
+        ASSERT_EQ(J_compact.rows(), active_idx.size());
+        ASSERT_EQ(J_compact.cols(), active_cols.size());
+
+        // active set is made of all pairs below the threshold
+        int n_active = 0;
+
+        for(int i = 0; i < d.size(); i++)
+        {
+            n_active += d[i] < th;
+        }
+
+        EXPECT_EQ(active_idx.size(), n_active);
+
+        for(int r = 0; r < active_idx.size(); r++)
+        {
+            int i = active_idx[r];
+
+            EXPECT_LT(d[i], th);
+
+            EXPECT_LT((J.row(r) - J_full.row(i)).lpNorm<Eigen::Infinity>(), 1e-12);
+
+            // columns outside the active ones must be zero
+            Eigen::RowVectorXd row = Eigen::RowVectorXd::Zero(model->getNv());
+
+            for(int c = 0; c < active_cols.size(); c++)
+            {
+                row[active_cols[c]] = J_compact(r, c);
+            }
+
+            EXPECT_LT((row - J_full.row(i)).lpNorm<Eigen::Infinity>(), 1e-12);
+        }
+    }
+}
 
 int main(int argc, char ** argv)
 {
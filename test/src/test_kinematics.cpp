@@ -1,5 +1,8 @@
 #include "common.h"
 
+#include <algorithm>
+#include <thread>
+
 
 using TestKinematics = TestWithModel;
 
@@ -61,6 +64,41 @@ TEST_F(TestKinematics, checkMapAccessorsWheel)
 
 }
 
+TEST_F(TestKinematics, checkStateLayout)
+{
+    auto addr = [](VecConstRef x)
+    {
+        return reinterpret_cast<std::uintptr_t>(x.data());
+    };
+
+    // state vectors share a contiguous buffer, each starting on a cache line
+    auto q = addr(model->getJointPosition());
+    auto v = addr(model->getJointVelocity());
+    auto a = addr(model->getJointAcceleration());
+    auto tau = addr(model->getJointEffort());
+
+    EXPECT_EQ(q % 64, 0);
+    EXPECT_EQ(v % 64, 0);
+    EXPECT_EQ(a % 64, 0);
+    EXPECT_EQ(tau % 64, 0);
+
+    EXPECT_GT(v, q);
+    EXPECT_GT(a, v);
+    EXPECT_GT(tau, a);
+    EXPECT_LT(tau - q, 4*64*(model->getNq()/8 + 1));
+
+    // joint views alias the model state
+    Eigen::VectorXd tau_new = Eigen::VectorXd::Random(model->getNv());
+    model->setJointEffort(tau_new);
+
+    for(auto jname : model->getJointNames())
+    {
+        auto j = model->getJoint(jname);
+        auto [iv, nv] = j->getJointInfo().inv();
+        EXPECT_TRUE(j->getJointEffort().isApprox(tau_new.segment(iv, nv)));
+    }
+}
+
 TEST_F(TestKinematics, checkMapMinimalToPosition)
 {
     Eigen::VectorXd q0 = model->generateRandomQ();
@@ -420,6 +458,102 @@ TEST_F(TestKinematics, checkJdotTimesV)
     std::cout << "getJdotTimesV requires " << dt/count*1e6 << " us \n";
 }
 
+TEST_F(TestKinematics, checkJacobianTimeVariation)
+{
+    const int nv = model->getNv();
+
+    for(int i = 0; i < 10; i++)
+    {
+        Eigen::VectorXd q0 = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+
+        const double h = 1e-4;
+
+        Eigen::VectorXd qplus; model->sum(q0, v*h/2, qplus);
+        Eigen::VectorXd qminus; model->sum(q0, -v*h/2, qminus);
+
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            model->setJointPosition(q0);
+            model->setJointVelocity(v);
+            model->setJointAcceleration(v*0);
+            model->update();
+
+            Eigen::MatrixXd dJ = model->getJacobianTimeVariation(lname);
+
+            // consistent with jdot times v
+            EXPECT_LT((dJ*v - model->getJdotTimesV(lname)).lpNorm<Eigen::Infinity>(), 1e-9) << lname;
+
+            // consistent with the numerical derivative of the jacobian
+            model->setJointPosition(qplus);
+            model->update();
+            Eigen::MatrixXd Jplus = model->getJacobian(lname);
+
+            model->setJointPosition(qminus);
+            model->update();
+            Eigen::MatrixXd Jminus = model->getJacobian(lname);
+
+            Eigen::MatrixXd dJ_hat = (Jplus - Jminus)/h;
+
+            EXPECT_LT((dJ_hat - dJ).lpNorm<Eigen::Infinity>(), 1e-3) << lname;
+        }
+    }
+}
+
+TEST_F(TestKinematics, checkKinematicsDerivatives)
+{
+    const int nv = model->getNv();
+
+    auto model_fd = model->clone();
+
+    Eigen::MatrixXd dv_dq(6, nv), dv_dv(6, nv);
+    Eigen::MatrixXd da_dq(6, nv), da_dv(6, nv), da_da(6, nv);
+
+    for(int i = 0; i < 5; i++)
+    {
+        Eigen::VectorXd q = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+
+        model->setJointPosition(q);
+        model->setJointVelocity(v);
+        model->setJointAcceleration(a);
+        model->update();
+
+        for(std::string lname : {"arm1_7", "arm2_7", "pelvis"})
+        {
+            int id = model->getLinkId(lname);
+
+            model->getVelocityTwistDerivatives(id, dv_dq, dv_dv);
+            model->getAccelerationTwistDerivatives(id, da_dq, da_dv, da_da);
+
+            Eigen::MatrixXd J = model->getJacobian(lname);
+            EXPECT_TRUE(dv_dv.isApprox(J)) << lname;
+            EXPECT_TRUE(da_da.isApprox(J)) << lname;
+
+            // compare with central differences of [vel; acc]
+            Eigen::MatrixXd df_dq, df_dv;
+
+            centralDifferences(*model, *model_fd,
+                               [id](const XBot::ModelInterface& m)
+                               {
+                                   Eigen::VectorXd f(12);
+                                   f << m.getVelocityTwist(id), m.getAccelerationTwist(id);
+                                   return f;
+                               },
+                               df_dq, df_dv);
+
+            Eigen::MatrixXd dv_dq_hat = df_dq.topRows<6>();
+            Eigen::MatrixXd da_dq_hat = df_dq.bottomRows<6>();
+            Eigen::MatrixXd da_dv_hat = df_dv.bottomRows<6>();
+
+            EXPECT_LT((dv_dq - dv_dq_hat).lpNorm<Eigen::Infinity>(), 1e-4) << lname;
+            EXPECT_LT((da_dq - da_dq_hat).lpNorm<Eigen::Infinity>(), 1e-4) << lname;
+            EXPECT_LT((da_dv - da_dv_hat).lpNorm<Eigen::Infinity>(), 1e-4) << lname;
+        }
+    }
+}
+
 TEST_F(TestKinematics, checkRelativeJacobian)
 {
     int count = 0;
@@ -867,6 +1001,152 @@ TEST_F(TestKinematics, checkRneaVsCrba)
 
 }
 
+TEST_F(TestKinematics, checkDynamicsDerivatives)
+{
+    const int nv = model->getNv();
+
+    auto model_fd = model->clone();
+
+    Eigen::MatrixXd dtau_dq(nv, nv), dtau_dv(nv, nv), dtau_da(nv, nv);
+    Eigen::MatrixXd dddq_dq(nv, nv), dddq_dv(nv, nv), dddq_dtau(nv, nv);
+
+    for(int i = 0; i < 10; i++)
+    {
+        Eigen::VectorXd q = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd tau = Eigen::VectorXd::Random(nv);
+
+        model->setJointPosition(q);
+        model->setJointVelocity(v);
+        model->setJointAcceleration(a);
+        model->setJointEffort(tau);
+        model->update();
+
+        model->computeInverseDynamicsDerivatives(dtau_dq, dtau_dv, dtau_da);
+        model->computeForwardDynamicsDerivatives(dddq_dq, dddq_dv, dddq_dtau);
+
+        // cached inertia and inverse inertia must be consistent
+        EXPECT_TRUE(dtau_da.isApprox(model->computeInertiaMatrix()));
+        EXPECT_TRUE((dddq_dtau*dtau_da).isApprox(Eigen::MatrixXd::Identity(nv, nv), 1e-6));
+
+        // compare with central differences of [tau; ddq]
+        Eigen::MatrixXd df_dq, df_dv;
+
+        centralDifferences(*model, *model_fd,
+                           [nv](const XBot::ModelInterface& m)
+                           {
+                               Eigen::VectorXd f(2*nv);
+                               f << m.computeInverseDynamics(), m.computeForwardDynamics();
+                               return f;
+                           },
+                           df_dq, df_dv);
+
+        Eigen::MatrixXd dtau_dq_hat = df_dq.topRows(nv);
+        Eigen::MatrixXd dddq_dq_hat = df_dq.bottomRows(nv);
+        Eigen::MatrixXd dtau_dv_hat = df_dv.topRows(nv);
+        Eigen::MatrixXd dddq_dv_hat = df_dv.bottomRows(nv);
+
+        EXPECT_LT((dtau_dq - dtau_dq_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+        EXPECT_LT((dtau_dv - dtau_dv_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+        EXPECT_LT((dddq_dq - dddq_dq_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+        EXPECT_LT((dddq_dv - dddq_dv_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+
+        // forward dynamics derivatives follow the (live) effort
+        model->setJointEffort(-tau);
+        Eigen::MatrixXd dddq_dq_1(nv, nv);
+        model->computeForwardDynamicsDerivatives(dddq_dq_1, dddq_dv, dddq_dtau);
+        model_fd->setJointPosition(q);
+        model_fd->setJointVelocity(v);
+        model_fd->setJointEffort(-tau);
+        model_fd->update();
+        Eigen::MatrixXd dddq_dq_2(nv, nv);
+        model_fd->computeForwardDynamicsDerivatives(dddq_dq_2, dddq_dv, dddq_dtau);
+        EXPECT_TRUE(dddq_dq_1.isApprox(dddq_dq_2));
+
+        // inverse dynamics derivatives after forward dynamics derivatives
+        // on the same q, v, a must match a fresh computation
+        model->setJointEffort(tau);
+        model->computeInverseDynamicsDerivatives(dtau_dq, dtau_dv, dtau_da);
+        model->computeForwardDynamicsDerivatives(dddq_dq, dddq_dv, dddq_dtau);
+        model->computeInverseDynamicsDerivatives(dtau_dq, dtau_dv, dtau_da);
+
+        auto model_fresh = model->clone();
+        model_fresh->setJointPosition(q);
+        model_fresh->setJointVelocity(v);
+        model_fresh->setJointAcceleration(a);
+        model_fresh->update();
+
+        Eigen::MatrixXd dtau_dq_ref(nv, nv), dtau_dv_ref(nv, nv), dtau_da_ref(nv, nv);
+        model_fresh->computeInverseDynamicsDerivatives(dtau_dq_ref, dtau_dv_ref, dtau_da_ref);
+
+        EXPECT_TRUE(dtau_dq.isApprox(dtau_dq_ref));
+        EXPECT_TRUE(dtau_dv.isApprox(dtau_dv_ref));
+        EXPECT_TRUE(dtau_da.isApprox(dtau_da_ref));
+    }
+}
+
+
+TEST_F(TestKinematics, checkCentroidalDynamicsDerivatives)
+{
+    const int nv = model->getNv();
+
+    auto model_fd = model->clone();
+
+    Eigen::MatrixXd dh_dq(6, nv), dhdot_dq(6, nv), dhdot_dv(6, nv), dhdot_da(6, nv);
+
+    for(int i = 0; i < 10; i++)
+    {
+        Eigen::VectorXd q = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+
+        model->setJointPosition(q);
+        model->setJointVelocity(v);
+        model->setJointAcceleration(a);
+        model->update();
+
+        Eigen::MatrixXd Ag = model->computeCentroidalMomentumMatrix();
+        Eigen::MatrixXd dAg = model->computeCentroidalMomentumMatrixTimeVariation();
+
+        model->computeCentroidalDynamicsDerivatives(dh_dq, dhdot_dq, dhdot_dv, dhdot_da);
+
+        EXPECT_TRUE(dhdot_da.isApprox(Ag));
+        EXPECT_TRUE(model->computeCentroidalMomentumMatrixDotTimesV().isApprox(dAg*v));
+
+        // compare with central differences of [h; hdot; vec(Ag)]
+        Eigen::MatrixXd df_dq, df_dv;
+
+        centralDifferences(*model, *model_fd,
+                           [nv](const XBot::ModelInterface& m)
+                           {
+                               Eigen::MatrixXd Agi = m.computeCentroidalMomentumMatrix();
+                               Eigen::VectorXd vi = m.getJointVelocity();
+                               Eigen::VectorXd f(12 + 6*nv);
+                               f << Agi*vi,
+                                   Agi*m.getJointAcceleration() +
+                                       m.computeCentroidalMomentumMatrixTimeVariation()*vi,
+                                   Eigen::Map<const Eigen::VectorXd>(Agi.data(), Agi.size());
+                               return f;
+                           },
+                           df_dq, df_dv);
+
+        // time variation along the current velocity
+        Eigen::VectorXd dAg_v = df_dq.bottomRows(6*nv)*v;
+        Eigen::MatrixXd dAg_hat = Eigen::Map<const Eigen::MatrixXd>(dAg_v.data(), 6, nv);
+        EXPECT_LT((dAg - dAg_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+
+        // partial derivatives
+        Eigen::MatrixXd dh_dq_hat = df_dq.topRows<6>();
+        Eigen::MatrixXd dhdot_dq_hat = df_dq.middleRows<6>(6);
+        Eigen::MatrixXd dhdot_dv_hat = df_dv.middleRows<6>(6);
+
+        EXPECT_LT((dh_dq - dh_dq_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+        EXPECT_LT((dhdot_dq - dhdot_dq_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+        EXPECT_LT((dhdot_dv - dhdot_dv_hat).lpNorm<Eigen::Infinity>(), 1e-3);
+    }
+}
+
 
 TEST_F(TestKinematics, checkInertiaInverse)
 {
@@ -947,6 +1227,227 @@ TEST_F(TestKinematics, checkInertiaInverse1)
 
 }
 
+TEST_F(TestKinematics, checkInertiaFactorization)
+{
+    const int nv = model->getNv();
+
+    for(int i = 0; i < 100; i++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+
+        Eigen::MatrixXd M = model->computeInertiaMatrix();
+
+        // vector
+        Eigen::VectorXd b = Eigen::VectorXd::Random(nv);
+        Eigen::VectorXd Minvb(nv);
+        model->computeInertiaInverseTimes(b, Minvb);
+        EXPECT_LT((M*Minvb - b).lpNorm<Eigen::Infinity>(), 1e-6);
+
+        // matrix
+        Eigen::MatrixXd B = Eigen::MatrixXd::Random(nv, 4);
+        Eigen::MatrixXd MinvB(nv, 4);
+        model->computeInertiaInverseTimes(B, MinvB);
+        EXPECT_LT((M*MinvB - B).lpNorm<Eigen::Infinity>(), 1e-6);
+
+        // stacked jacobians
+        Eigen::MatrixXd J(12, nv);
+        J << model->getJacobian("arm1_7"), model->getJacobian("arm2_7");
+        Eigen::MatrixXd Linv(12, 12);
+        model->computeInverseOperationalSpaceInertia(J, Linv);
+
+        Eigen::MatrixXd Linv_ref = J * M.inverse() * J.transpose();
+        EXPECT_LT((Linv - Linv_ref).lpNorm<Eigen::Infinity>(), 1e-6);
+
+        // generic implementation (dense ldlt)
+        Eigen::MatrixXd Linv_ldlt(12, 12);
+        model->XBotInterface::computeInverseOperationalSpaceInertia(J, Linv_ldlt);
+        EXPECT_LT((Linv_ldlt - Linv_ref).lpNorm<Eigen::Infinity>(), 1e-6);
+
+        Eigen::MatrixXd Linv_wrong(6, 6);
+        EXPECT_THROW(model->XBotInterface::computeInverseOperationalSpaceInertia(J, Linv_wrong),
+                     std::out_of_range);
+
+        // size checks of the (virtual) implementation
+        EXPECT_THROW(model->computeInverseOperationalSpaceInertia(J, Linv_wrong),
+                     std::out_of_range);
+
+        Eigen::MatrixXd J_wrong(12, nv + 1);
+        EXPECT_THROW(model->computeInverseOperationalSpaceInertia(J_wrong, Linv),
+                     std::out_of_range);
+
+        Eigen::MatrixXd MinvB_wrong(nv, 3);
+        EXPECT_THROW(model->computeInertiaInverseTimes(B, MinvB_wrong),
+                     std::out_of_range);
+
+        Eigen::MatrixXd B_wrong(nv + 1, 4);
+        EXPECT_THROW(model->computeInertiaInverseTimes(B_wrong, MinvB),
+                     std::out_of_range);
+    }
+}
+
+TEST_F(TestKinematics, checkOperationalSpaceInertia)
+{
+    const int nv = model->getNv();
+
+    std::vector<int> link_ids = {
+        model->getLinkId("arm1_7"),
+        model->getLinkId("arm2_7")
+    };
+
+    for(int i = 0; i < 100; i++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+
+        Eigen::MatrixXd M = model->computeInertiaMatrix();
+        Eigen::MatrixXd J(12, nv);
+        J << model->getJacobian("arm1_7"), model->getJacobian("arm2_7");
+
+        Eigen::MatrixXd Lambda_ref = (J * M.inverse() * J.transpose()).inverse();
+
+        Eigen::MatrixXd Lambda(12, 12);
+        model->computeOperationalSpaceInertia(link_ids, Lambda);
+        EXPECT_TRUE(Lambda.isApprox(Lambda_ref, 1e-6));
+
+        Eigen::MatrixXd Lambda1(6, 6);
+        model->computeOperationalSpaceInertia(link_ids[1], Lambda1);
+        EXPECT_TRUE(Lambda1.isApprox((J.bottomRows<6>() * M.inverse() * J.bottomRows<6>().transpose()).inverse(), 1e-6));
+
+        // dynamically consistent inverse is a right inverse of J
+        Eigen::MatrixXd Jbar(nv, 12);
+        model->computeDynamicallyConsistentInverse(link_ids, Jbar);
+        EXPECT_TRUE((J * Jbar).isApprox(Eigen::MatrixXd::Identity(12, 12), 1e-6));
+        EXPECT_TRUE(Jbar.isApprox(M.inverse() * J.transpose() * Lambda_ref, 1e-6));
+
+        // cached result must be consistent
+        model->computeOperationalSpaceInertia(link_ids, Lambda);
+        EXPECT_TRUE(Lambda.isApprox(Lambda_ref, 1e-6));
+    }
+
+    Eigen::MatrixXd Lambda_wrong(6, 6);
+    EXPECT_THROW(model->computeOperationalSpaceInertia(link_ids, Lambda_wrong),
+                 std::out_of_range);
+
+    // several link sets are cached at the same time
+    std::vector<int> link_ids_alt = {model->getLinkId("arm1_7")};
+
+    Eigen::MatrixXd Lambda(12, 12), Lambda_alt(6, 6), Lambda_ref(12, 12);
+    model->computeOperationalSpaceInertia(link_ids, Lambda_ref);
+
+    for(int i = 0; i < 3; i++)
+    {
+        model->computeOperationalSpaceInertia(link_ids_alt, Lambda_alt);
+        model->computeOperationalSpaceInertia(link_ids, Lambda);
+        EXPECT_TRUE(Lambda.isApprox(Lambda_ref));
+    }
+
+    // a rank deficient stacked jacobian is rejected
+    std::vector<int> link_ids_dup = {link_ids[0], link_ids[0]};
+    Eigen::MatrixXd Jbar_dup(nv, 12);
+    EXPECT_THROW(model->computeOperationalSpaceInertia(link_ids_dup, Lambda),
+                 std::runtime_error);
+    EXPECT_THROW(model->computeDynamicallyConsistentInverse(link_ids_dup, Jbar_dup),
+                 std::runtime_error);
+}
+
+TEST_F(TestKinematics, checkConstrainedDynamics)
+{
+    using ContactType = ModelInterface::ContactType;
+
+    const int nv = model->getNv();
+
+    EXPECT_FALSE(model->setContacts(std::vector<std::string>{"arm1_7", "not_exist"},
+                                    {ContactType::Point3D, ContactType::Frame6D}));
+
+    ASSERT_TRUE(model->setContacts(std::vector<std::string>{"arm1_7", "arm2_7"},
+                                   {ContactType::Point3D, ContactType::Frame6D}));
+
+    ASSERT_EQ(model->getContactDimension(), 9);
+
+    Eigen::VectorXd ddq(nv), lambda(9);
+
+    for(int i = 0; i < 100; i++)
+    {
+        // note: with zero velocity the 6D constraint on the spatial
+        // acceleration is equivalent to the classical one
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv) * (i % 2);
+        Eigen::VectorXd tau = Eigen::VectorXd::Random(nv);
+
+        model->setJointPosition(model->generateRandomQ());
+        model->setJointVelocity(v);
+        model->setJointEffort(tau);
+        model->update();
+
+        model->computeConstrainedDynamics(ddq, lambda);
+
+        Eigen::MatrixXd Jc(9, nv);
+        Jc << model->getJacobian("arm1_7").topRows<3>(), model->getJacobian("arm2_7");
+
+        // equations of motion
+        Eigen::VectorXd eom_err = model->computeInertiaMatrix()*ddq +
+                                  model->computeNonlinearTerm() -
+                                  tau - Jc.transpose()*lambda;
+
+        EXPECT_LT(eom_err.lpNorm<Eigen::Infinity>(), 1e-6);
+
+        // constraints
+        Eigen::Vector3d a1 = Jc.topRows<3>()*ddq + model->getJdotTimesV("arm1_7").head<3>();
+        EXPECT_LT(a1.lpNorm<Eigen::Infinity>(), 1e-6);
+
+        if(i % 2 == 0)
+        {
+            Eigen::Vector6d a2 = Jc.bottomRows<6>()*ddq + model->getJdotTimesV("arm2_7");
+            EXPECT_LT(a2.lpNorm<Eigen::Infinity>(), 1e-6);
+        }
+
+        // cached result follows the live effort
+        model->setJointEffort(-tau);
+        Eigen::VectorXd ddq_neg(nv), lambda_neg(9);
+        model->computeConstrainedDynamics(ddq_neg, lambda_neg);
+        EXPECT_FALSE(ddq_neg.isApprox(ddq));
+    }
+
+    Eigen::VectorXd lambda_wrong(3);
+    EXPECT_THROW(model->computeConstrainedDynamics(ddq, lambda_wrong), std::out_of_range);
+}
+
+TEST_F(TestKinematics, checkImpulseDynamics)
+{
+    using ContactType = ModelInterface::ContactType;
+
+    const int nv = model->getNv();
+
+    ASSERT_TRUE(model->setContacts(std::vector<std::string>{"arm1_7", "arm2_7"},
+                                   {ContactType::Point3D, ContactType::Frame6D}));
+
+    Eigen::VectorXd v_after(nv), impulse(9);
+
+    for(int i = 0; i < 100; i++)
+    {
+        Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+        double restitution = 0.5 * (i % 2);
+
+        model->setJointPosition(model->generateRandomQ());
+        model->setJointVelocity(v);
+        model->update();
+
+        model->computeImpulseDynamics(v_after, impulse, restitution);
+
+        Eigen::MatrixXd Jc(9, nv);
+        Jc << model->getJacobian("arm1_7").topRows<3>(), model->getJacobian("arm2_7");
+
+        // momentum jump
+        Eigen::VectorXd err = model->computeInertiaMatrix()*(v_after - v) -
+                              Jc.transpose()*impulse;
+        EXPECT_LT(err.lpNorm<Eigen::Infinity>(), 1e-6);
+
+        // contact velocity after impact
+        Eigen::VectorXd vc_err = Jc*v_after + restitution*Jc*v;
+        EXPECT_LT(vc_err.lpNorm<Eigen::Infinity>(), 1e-6);
+    }
+}
+
 TEST_F(TestKinematics, checkCmmVsCm)
 {
     int count = 0;
@@ -1176,6 +1677,711 @@ TEST_F(TestKinematics, checkAddBody)
 
 }
 
+TEST_F(TestKinematics, checkLazyUpdate)
+{
+    auto model_ref = model->clone();
+
+    std::string l1 = "arm1_7", l2 = "arm2_7";
+
+    Eigen::MatrixXd J1(6, model->getNv()), J2(6, model->getNv());
+
+    int count = 0;
+    double dt = 0;
+
+    for(int i = 0; i < 100; i++)
+    {
+        Eigen::VectorXd q = model->generateRandomQ();
+        Eigen::VectorXd v = Eigen::VectorXd::Random(model->getNv());
+        Eigen::VectorXd a = Eigen::VectorXd::Random(model->getNv());
+        Eigen::VectorXd tau = Eigen::VectorXd::Random(model->getNv());
+
+        for(auto m : {model.get(), model_ref.get()})
+        {
+            m->setJointPosition(q);
+            m->setJointVelocity(v);
+            m->setJointAcceleration(a);
+            m->setJointEffort(tau);
+        }
+
+        model_ref->update();
+
+        // typical whole-body control query
+        TIC();
+        model->update();
+        model->computeGravityCompensation();
+        model->getJacobian(l1, J1);
+        model->getJacobian(l2, J2);
+        dt += TOC();
+        count++;
+
+        EXPECT_TRUE(J1.isApprox(model_ref->getJacobian(l1)));
+        EXPECT_TRUE(J2.isApprox(model_ref->getJacobian(l2)));
+
+        // forward dynamics must not corrupt kinematics computed afterwards
+        EXPECT_TRUE(model->computeForwardDynamics().isApprox(model_ref->computeForwardDynamics()));
+
+        for(auto lname : {l1, l2})
+        {
+            EXPECT_TRUE(model->getAccelerationTwist(lname).isApprox(model_ref->getAccelerationTwist(lname)));
+            EXPECT_TRUE(model->getVelocityTwist(lname).isApprox(model_ref->getVelocityTwist(lname)));
+            EXPECT_TRUE(model->getPose(lname).isApprox(model_ref->getPose(lname)));
+        }
+
+        EXPECT_TRUE(model->getCOMAcceleration().isApprox(model_ref->getCOMAcceleration()));
+
+        // setting the state without calling update() does not affect kinematics
+        model->setJointPosition(model->generateRandomQ());
+        EXPECT_TRUE(model->getPose(l1).isApprox(model_ref->getPose(l1)));
+    }
+
+    std::cout << "update + gcomp + 2 jacobians requires " << dt/count*1e6 << " us \n";
+}
+
+TEST_F(TestKinematics, checkHotLinks)
+{
+    auto model_ref = model->clone();
+
+    EXPECT_FALSE(model->setHotLinks(std::vector<std::string>{"arm1_7", "not_exist"}));
+    EXPECT_THROW(model->setHotLinks(std::vector<int>{-1}), std::out_of_range);
+    ASSERT_TRUE(model->setHotLinks(std::vector<std::string>{"arm1_7", "arm2_7", "pelvis"}));
+
+    for(int i = 0; i < 10; i++)
+    {
+        Eigen::VectorXd q = model->generateRandomQ();
+
+        model->setJointPosition(q);
+        model->update();
+
+        model_ref->setJointPosition(q);
+        model_ref->update();
+
+        // query jacobians first, so that the position pass is
+        // performed by computeJointJacobians
+        if(i % 2)
+        {
+            model->getJacobian("arm1_7");
+        }
+
+        // hot and non-hot links must be consistent with the reference model
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            EXPECT_TRUE(model->getPose(lname).isApprox(model_ref->getPose(lname))) << lname;
+        }
+    }
+}
+
+TEST_F(TestKinematics, checkJacobianPathSelection)
+{
+    auto opt = model->getConfigOptions();
+    opt.set_parameter("jacobian_full_sweep_threshold", 3);
+    auto m = XBot::ModelInterface::getModel(opt);
+
+    std::vector<std::string> links = {"arm1_7", "arm2_7", "pelvis", "ball1_tip", "ball2_tip"};
+
+    auto run_cycle = [&](int n_links)
+    {
+        Eigen::VectorXd q = m->generateRandomQ();
+        m->setJointPosition(q);
+        m->update();
+        model->setJointPosition(q);
+        model->update();
+
+        Eigen::MatrixXd J(6, m->getNv());
+
+        for(int i = 0; i < n_links; i++)
+        {
+            m->getJacobian(m->getLinkId(links[i]), J);
+            EXPECT_TRUE(J.isApprox(model->getJacobian(links[i]))) << links[i];
+
+            m->getJacobianInWorld(m->getLinkId(links[i]), J);
+            EXPECT_TRUE(J.isApprox(model->getJacobianInWorld(links[i]))) << links[i];
+        }
+    };
+
+    // few jacobians per cycle: single frame path
+    run_cycle(2);
+    run_cycle(2);
+    m->resetComputationStatistics();
+    run_cycle(2);
+
+    auto stats = m->getComputationStatistics();
+    EXPECT_EQ(stats["jacobian_single_frame"], 4);
+    EXPECT_EQ(stats["jacobian_full_sweep"], 0);
+
+    // many jacobians per cycle: after the first cycle, the whole tree is swept once
+    run_cycle(5);
+    m->resetComputationStatistics();
+    run_cycle(5);
+
+    stats = m->getComputationStatistics();
+    EXPECT_EQ(stats["jacobian_single_frame"], 0);
+    EXPECT_EQ(stats["jacobian_full_sweep"], 1);
+    EXPECT_EQ(stats["jacobian_from_full_sweep"], 10);
+}
+
+TEST_F(TestKinematics, checkWorkspace)
+{
+    const int n_threads = 4;
+    const int n_samples = 100;
+
+    int id = model->getLinkId("arm1_7");
+    int nv = model->getNv();
+
+    // reference values from the model state
+    std::vector<Eigen::VectorXd> qs;
+    std::vector<Eigen::Affine3d> T_ref;
+    std::vector<Eigen::MatrixXd> J_ref, M_ref;
+    std::vector<Eigen::VectorXd> g_ref;
+
+    for(int i = 0; i < n_threads*n_samples; i++)
+    {
+        qs.push_back(model->generateRandomQ());
+        model->setJointPosition(qs.back());
+        model->setJointVelocity(Eigen::VectorXd::Zero(nv));
+        model->setJointAcceleration(Eigen::VectorXd::Zero(nv));
+        model->update();
+        T_ref.push_back(model->getPose(id));
+        J_ref.push_back(model->getJacobian("arm1_7"));
+        M_ref.push_back(model->computeInertiaMatrix());
+        g_ref.push_back(model->computeGravityCompensation());
+    }
+
+    Eigen::Affine3d T_model = model->getPose(id);
+
+    // a workspace is initialized with the model state
+    auto ws0 = model->createWorkspace();
+    EXPECT_TRUE(model->getPose(*ws0, id).isApprox(T_model));
+
+    // a workspace from another model must be rejected
+    auto other = model->clone();
+    EXPECT_THROW(other->getPose(*ws0, id), std::invalid_argument);
+
+    // concurrent queries on the shared model
+    std::vector<int> errors(n_threads, 0);
+    std::vector<std::thread> threads;
+
+    for(int t = 0; t < n_threads; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            auto ws = model->createWorkspace();
+            Eigen::MatrixXd J(6, nv);
+
+            for(int i = t*n_samples; i < (t + 1)*n_samples; i++)
+            {
+                model->updateWorkspace(*ws, qs[i]);
+                model->getJacobian(*ws, id, J);
+
+                errors[t] += !model->getPose(*ws, id).isApprox(T_ref[i]);
+                errors[t] += !J.isApprox(J_ref[i]);
+                errors[t] += !model->computeInertiaMatrix(*ws).isApprox(M_ref[i]);
+                errors[t] += !model->computeGravityCompensation(*ws).isApprox(g_ref[i]);
+            }
+        });
+    }
+
+    for(auto& th : threads)
+    {
+        th.join();
+    }
+
+    for(int t = 0; t < n_threads; t++)
+    {
+        EXPECT_EQ(errors[t], 0) << "thread " << t;
+    }
+
+    // model state is unaffected
+    EXPECT_TRUE(model->getPose(id).isApprox(T_model));
+}
+
+TEST_F(TestKinematics, checkBatch)
+{
+    const int n_samples = 200;
+
+    std::vector<int> link_ids = {
+        model->getLinkId("arm1_7"),
+        model->getLinkId("arm2_7"),
+        model->getLinkId("pelvis")
+    };
+
+    Eigen::MatrixXd Q(model->getNq(), n_samples);
+
+    for(int i = 0; i < n_samples; i++)
+    {
+        Q.col(i) = model->generateRandomQ();
+    }
+
+    XBot::ModelInterface::BatchData bd;
+    bd.link_ids = link_ids;
+    bd.computation = bd.Poses | bd.Jacobians | bd.GravityCompensation | bd.InertiaMatrix;
+
+    EXPECT_THROW(model->evaluateBatch(Q, bd), std::out_of_range);
+
+    bd.resize(*model, n_samples);
+
+    const int nv = model->getNv();
+    const int nlinks = link_ids.size();
+
+    // model state must not be affected
+    Eigen::VectorXd q0 = model->generateRandomQ();
+    model->setJointPosition(q0);
+    model->update();
+    Eigen::Affine3d T0 = model->getPose(link_ids[0]);
+
+    for(int n_threads : {1, 4})
+    {
+        TIC(batch);
+        model->evaluateBatch(Q, bd, n_threads);
+        double dt_batch = TOC(batch);
+
+        std::cout << "evaluateBatch (" << n_threads << " threads) requires " <<
+            dt_batch/n_samples*1e6 << " us per sample \n";
+
+        EXPECT_TRUE(model->getPose(link_ids[0]).isApprox(T0));
+        EXPECT_TRUE(model->getJointPosition().isApprox(q0));
+
+        auto model_seq = model->clone();
+
+        for(int i = 0; i < n_samples; i++)
+        {
+            model_seq->setJointPosition(Q.col(i));
+            model_seq->update();
+
+            for(int k = 0; k < nlinks; k++)
+            {
+                EXPECT_TRUE(bd.poses[i*nlinks + k].isApprox(model_seq->getPose(link_ids[k])));
+
+                Eigen::MatrixXd J(6, nv);
+                model_seq->getJacobian(link_ids[k], J);
+                EXPECT_TRUE(bd.jacobians.block(6*k, nv*i, 6, nv).isApprox(J));
+            }
+
+            EXPECT_TRUE(bd.gcomp.col(i).isApprox(model_seq->computeGravityCompensation()));
+
+            EXPECT_TRUE(bd.inertia.middleCols(nv*i, nv).isApprox(model_seq->computeInertiaMatrix()));
+        }
+    }
+}
+
+TEST_F(TestKinematics, checkBatchConcurrentCalls)
+{
+    const int n_samples = 50;
+
+    Eigen::MatrixXd Q1(model->getNq(), n_samples), Q2(model->getNq(), n_samples);
+
+    for(int i = 0; i < n_samples; i++)
+    {
+        Q1.col(i) = model->generateRandomQ();
+        Q2.col(i) = model->generateRandomQ();
+    }
+
+    XBot::ModelInterface::BatchData bd1, bd2;
+    bd1.computation = bd2.computation = bd1.GravityCompensation | bd1.InertiaMatrix;
+    bd1.resize(*model, n_samples);
+    bd2.resize(*model, n_samples);
+
+    // concurrent calls on the same model share its workers and
+    // workspaces, hence they must be serialized
+    for(int k = 0; k < 10; k++)
+    {
+        std::thread th([&](){ model->evaluateBatch(Q1, bd1, 2); });
+        model->evaluateBatch(Q2, bd2, 2);
+        th.join();
+
+        auto model_seq = model->clone();
+
+        for(int i = 0; i < n_samples; i++)
+        {
+            model_seq->setJointPosition(Q1.col(i));
+            model_seq->update();
+            EXPECT_TRUE(bd1.gcomp.col(i).isApprox(model_seq->computeGravityCompensation()));
+
+            model_seq->setJointPosition(Q2.col(i));
+            model_seq->update();
+            EXPECT_TRUE(bd2.gcomp.col(i).isApprox(model_seq->computeGravityCompensation()));
+        }
+    }
+}
+
+TEST_F(TestKinematics, checkJacobianCompact)
+{
+    const int nv = model->getNv();
+
+    for(int i = 0; i < 10; i++)
+    {
+        model->setJointPosition(model->generateRandomQ());
+        model->update();
+
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            int id = model->getLinkId(lname);
+
+            if(id < 0)
+            {
+                continue;
+            }
+
+            const auto& support = model->getJacobianSupport(id);
+
+            EXPECT_TRUE(std::is_sorted(support.begin(), support.end())) << lname;
+
+            Eigen::MatrixXd J(6, nv);
+            model->getJacobian(id, J);
+
+            Eigen::MatrixXd Jc(6, support.size());
+            model->getJacobianCompact(id, Jc);
+
+            // compact jacobian contains the support columns
+            for(int k = 0; k < support.size(); k++)
+            {
+                EXPECT_TRUE(Jc.col(k).isApprox(J.col(support[k]))) << lname;
+            }
+
+            // all remaining columns are zero
+            for(int c = 0; c < nv; c++)
+            {
+                if(!std::binary_search(support.begin(), support.end(), c))
+                {
+                    EXPECT_TRUE(J.col(c).isZero()) << lname << " col " << c;
+                }
+            }
+        }
+    }
+
+    Eigen::MatrixXd Jc(6, 1);
+    EXPECT_THROW(model->getJacobianCompact(model->getLinkId("arm1_7"), Jc),
+                 std::out_of_range);
+}
+
+TEST_F(TestKinematics, checkFloatKinematics)
+{
+    auto opt = model->getConfigOptions();
+    opt.set_parameter("kinematics_precision", std::string("float"));
+    auto m = XBot::ModelInterface::getModel(opt);
+
+    int count = 0;
+    double dt_pose = 0, dt_pose_f = 0;
+    double dt_jac = 0, dt_jac_f = 0;
+
+    Eigen::MatrixXd J(6, m->getNv()), Jf(6, m->getNv());
+
+    for(int i = 0; i < 100; i++)
+    {
+        Eigen::VectorXd q = m->generateRandomQ();
+        m->setJointPosition(q);
+        m->update();
+        model->setJointPosition(q);
+        model->update();
+
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            int id = model->getLinkId(lname);
+
+            TIC(pose);
+            Eigen::Affine3d T = model->getPose(id);
+            dt_pose += TOC(pose);
+
+            TIC(pose_f);
+            Eigen::Affine3d Tf = m->getPose(id);
+            dt_pose_f += TOC(pose_f);
+
+            TIC(jac);
+            model->getJacobian(id, J);
+            dt_jac += TOC(jac);
+
+            TIC(jac_f);
+            m->getJacobian(id, Jf);
+            dt_jac_f += TOC(jac_f);
+
+            count++;
+
+            EXPECT_LT((T.matrix() - Tf.matrix()).lpNorm<Eigen::Infinity>(), 1e-4) << lname;
+            EXPECT_LT((J - Jf).lpNorm<Eigen::Infinity>(), 1e-4) << lname;
+        }
+    }
+
+    std::cout << "getPose requires " << dt_pose/count*1e6 << " us (double), "
+              << dt_pose_f/count*1e6 << " us (float) \n";
+    std::cout << "getJacobian requires " << dt_jac/count*1e6 << " us (double), "
+              << dt_jac_f/count*1e6 << " us (float) \n";
+
+    // few jacobians per cycle: the float path must not sweep the whole tree
+    int id = model->getLinkId("arm1_7");
+    double dt_few = 0, dt_few_f = 0;
+
+    m->resetComputationStatistics();
+
+    for(int i = 0; i < 100; i++)
+    {
+        Eigen::VectorXd q = m->generateRandomQ();
+        m->setJointPosition(q);
+        m->update();
+        model->setJointPosition(q);
+        model->update();
+
+        TIC(jac);
+        model->getJacobian(id, J);
+        dt_few += TOC(jac);
+
+        TIC(jac_f);
+        m->getJacobian(id, Jf);
+        dt_few_f += TOC(jac_f);
+
+        EXPECT_LT((J - Jf).lpNorm<Eigen::Infinity>(), 1e-4);
+    }
+
+    auto stats = m->getComputationStatistics();
+    EXPECT_GT(stats["jacobian_single_frame"], 0);
+
+    std::cout << "single getJacobian per cycle requires " << dt_few/100*1e6 << " us (double), "
+              << dt_few_f/100*1e6 << " us (float) \n";
+
+    opt.set_parameter("kinematics_precision", std::string("half"));
+    EXPECT_THROW(XBot::ModelInterface::getModel(opt), std::invalid_argument);
+}
+
+TEST_F(TestKinematics, checkComputationCache)
+{
+    model->setJointPosition(model->generateRandomQ());
+    model->setJointVelocity(Eigen::VectorXd::Random(model->getNv()));
+    model->setJointEffort(Eigen::VectorXd::Random(model->getNv()));
+    model->update();
+
+    model->resetComputationStatistics();
+
+    // repeated queries within the same cycle are served from the cache
+    Eigen::MatrixXd Jcom = model->getCOMJacobian();
+    EXPECT_TRUE(Jcom.isApprox(model->getCOMJacobian()));
+
+    Eigen::VectorXd ddq = model->computeForwardDynamics();
+    EXPECT_TRUE(ddq.isApprox(model->computeForwardDynamics()));
+
+    double mass = model->getMass();
+
+    auto stats = model->getComputationStatistics();
+    EXPECT_EQ(stats["com_jacobian_miss"], 1);
+    EXPECT_EQ(stats["com_jacobian_hit"], 1);
+    EXPECT_EQ(stats["forward_dynamics_miss"], 1);
+    EXPECT_EQ(stats["forward_dynamics_hit"], 1);
+
+    // the mass is only recomputed by update() when attached bodies
+    // change, so that getMass() is a pure read (not a memoized computation)
+    EXPECT_FALSE(stats.contains("mass_hit"));
+    EXPECT_FALSE(stats.contains("mass_miss"));
+
+    // the forward dynamics depends on the effort, which is not
+    // part of the recorded state
+    Eigen::VectorXd tau = Eigen::VectorXd::Random(model->getNv());
+    model->setJointEffort(tau);
+    Eigen::VectorXd ddq_new = model->computeForwardDynamics();
+    Eigen::MatrixXd M = model->computeInertiaMatrix();
+    Eigen::VectorXd h = model->computeNonlinearTerm();
+    EXPECT_LT((M*ddq_new + h - tau).lpNorm<Eigen::Infinity>(), 1e-6);
+
+    // new cycle: state-dependent caches are invalidated
+    model->setJointPosition(model->generateRandomQ());
+    model->update();
+    model->resetComputationStatistics();
+
+    model->getCOMJacobian();
+
+    stats = model->getComputationStatistics();
+    EXPECT_EQ(stats["com_jacobian_miss"], 1);
+
+    // attached body inertia changes trigger a mass update
+    Eigen::Affine3d T;
+    T.setIdentity();
+    int lid = model->addFixedLink("cache_link", "pelvis", 10.0, Eigen::Matrix3d::Identity(), T);
+    model->update();
+    EXPECT_DOUBLE_EQ(model->getMass(), mass + 10.0);
+
+    model->updateFixedLink(lid, 20.0, Eigen::Matrix3d::Identity(), T);
+    model->update();
+    EXPECT_DOUBLE_EQ(model->getMass(), mass + 20.0);
+}
+
+TEST_F(TestKinematics, checkIncrementalKinematics)
+{
+    auto opt = model->getConfigOptions();
+    opt.set_parameter("incremental_kinematics", false);
+    auto model_full = XBot::ModelInterface::getModel(opt);
+
+    const int nv = model->getNv();
+
+    std::vector<std::string> arm_joints;
+    for(int i = 1; i <= 6; i++)
+    {
+        arm_joints.push_back("j_arm1_" + std::to_string(i));
+    }
+
+    Eigen::VectorXd q = model->generateRandomQ();
+    Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+    Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+
+    auto set_state = [&](XBot::ModelInterface& m)
+    {
+        m.setJointPosition(q);
+        m.setJointVelocity(v);
+        m.setJointAcceleration(a);
+        m.update();
+    };
+
+    auto check_all_links = [&]()
+    {
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            int id = model->getLinkId(lname);
+            EXPECT_TRUE(model->getPose(id).isApprox(model_full->getPose(id))) << lname;
+            EXPECT_TRUE(model->getVelocityTwist(id).isApprox(model_full->getVelocityTwist(id))) << lname;
+            EXPECT_TRUE(model->getAccelerationTwist(id).isApprox(model_full->getAccelerationTwist(id))) << lname;
+        }
+    };
+
+    set_state(*model);
+    set_state(*model_full);
+    check_all_links();
+
+    model->resetComputationStatistics();
+
+    for(int k = 0; k < 20; k++)
+    {
+        // only the arm moves
+        for(auto jname : arm_joints)
+        {
+            q[model->getQIndex(jname)] += 0.01;
+            v[model->getVIndex(jname)] += 0.1;
+        }
+
+        set_state(*model);
+        set_state(*model_full);
+        check_all_links();
+    }
+
+    auto stats = model->getComputationStatistics();
+    EXPECT_EQ(stats["kinematics_full_pass"], 0);
+    EXPECT_EQ(stats["kinematics_incremental_pass"], 20);
+    EXPECT_LT(stats["kinematics_incremental_joints"], 20*model->getJointNum()/2);
+
+    // algorithms overwriting the stored accelerations force a full pass
+    model->computeForwardDynamics();
+    model->resetComputationStatistics();
+    model->getAccelerationTwist("arm1_7");
+    stats = model->getComputationStatistics();
+    EXPECT_EQ(stats["kinematics_full_pass"], 1);
+    EXPECT_TRUE(model->getAccelerationTwist("arm1_7").isApprox(model_full->getAccelerationTwist("arm1_7")));
+}
+
+TEST_F(TestKinematics, checkIncrementalKinematicsOverwrite)
+{
+    auto opt = model->getConfigOptions();
+    opt.set_parameter("incremental_kinematics", false);
+    auto model_full = XBot::ModelInterface::getModel(opt);
+
+    const int nv = model->getNv();
+
+    Eigen::VectorXd qa = model->generateRandomQ();
+    Eigen::VectorXd qb = model->generateRandomQ();
+    Eigen::VectorXd v = Eigen::VectorXd::Random(nv);
+    Eigen::VectorXd a = Eigen::VectorXd::Random(nv);
+
+    auto set_state = [&](XBot::ModelInterface& m, const Eigen::VectorXd& q)
+    {
+        m.setJointPosition(q);
+        m.setJointVelocity(v);
+        m.setJointAcceleration(a);
+        m.update();
+    };
+
+    auto check_all_links = [&]()
+    {
+        for(auto [lname, lptr] : model->getUrdf()->links_)
+        {
+            int id = model->getLinkId(lname);
+            EXPECT_TRUE(model->getPose(id).isApprox(model_full->getPose(id))) << lname;
+            EXPECT_TRUE(model->getVelocityTwist(id).isApprox(model_full->getVelocityTwist(id))) << lname;
+            EXPECT_TRUE(model->getAccelerationTwist(id).isApprox(model_full->getAccelerationTwist(id))) << lname;
+        }
+    };
+
+    Eigen::MatrixXd J, J_full;
+
+    // state A: kinematics is computed and stored
+    set_state(*model, qa);
+    set_state(*model_full, qa);
+    check_all_links();
+
+    // state B: only dynamics and a single jacobian are queried, these
+    // overwrite the kinematics stored inside data
+    set_state(*model, qb);
+    set_state(*model_full, qb);
+    model->computeInverseDynamics();
+    model->computeInertiaMatrix();
+    model->getJacobian("arm1_7", J);
+    model_full->getJacobian("arm1_7", J_full);
+    EXPECT_TRUE(J.isApprox(J_full));
+
+    // back to state A: the joints did not change w.r.t. the last
+    // kinematics pass, but the stored kinematics is stale
+    set_state(*model, qa);
+    set_state(*model_full, qa);
+    check_all_links();
+
+    // force the full sweep jacobian path
+    for(auto [lname, lptr] : model->getUrdf()->links_)
+    {
+        model->getJacobian(lname, J);
+        model_full->getJacobian(lname, J_full);
+        EXPECT_TRUE(J.isApprox(J_full)) << lname;
+    }
+}
+
+TEST_F(TestKinematics, checkRegressor)
+{
+    const int n_samples = 100;
+    const int nv = model->getNv();
+
+    Eigen::VectorXd pi = model->getDynamicParameters();
+
+    Eigen::MatrixXd Q(model->getNq(), n_samples);
+    Eigen::MatrixXd V = Eigen::MatrixXd::Random(nv, n_samples);
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(nv, n_samples);
+
+    for(int i = 0; i < n_samples; i++)
+    {
+        Q.col(i) = model->generateRandomQ();
+    }
+
+    XBot::ModelInterface::BatchData bd;
+    bd.computation = bd.Regressor;
+    bd.resize(*model, n_samples);
+
+    ASSERT_EQ(bd.regressor.rows(), nv*n_samples);
+    ASSERT_EQ(bd.regressor.cols(), pi.size());
+
+    // velocities and accelerations are required
+    EXPECT_THROW(model->evaluateBatch(Q, bd), std::invalid_argument);
+
+    model->evaluateBatch(Q, V, A, bd, 4);
+
+    for(int i = 0; i < n_samples; i++)
+    {
+        model->setJointPosition(Q.col(i));
+        model->setJointVelocity(V.col(i));
+        model->setJointAcceleration(A.col(i));
+        model->update();
+
+        Eigen::MatrixXd Y = model->computeRegressor();
+
+        ASSERT_EQ(Y.rows(), nv);
+        ASSERT_EQ(Y.cols(), pi.size());
+
+        Eigen::VectorXd tau = model->computeInverseDynamics();
+
+        EXPECT_LT((Y*pi - tau).lpNorm<Eigen::Infinity>(), 1e-6);
+        EXPECT_TRUE(bd.regressor.middleRows(nv*i, nv).isApprox(Y));
+    }
+}
+
 
 int main(int argc, char ** argv)
 {
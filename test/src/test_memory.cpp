@@ -3,6 +3,7 @@
 #include "malloc.h"
 
 #include <xbot2_interface/collision.h>
+#include <fmt/format.h>
 
 using TestMemory = TestWithModel;
 
@@ -243,11 +244,29 @@ TEST_F(TestMemory, checkCollisionModelMalloc)
     tracing_enabled = true;
     XBot::Collision::CollisionModel cm(model);
     tracing_enabled = false;
-    Eigen::VectorXd d(cm.getNumCollisionPairs());
-    Eigen::MatrixXd J(d.size(), model->getNv());
     EXPECT_GT(malloc_calls, 0) << "CollisionModel";
     EXPECT_GT(free_calls, 0) << "CollisionModel";
 
+    // a few environment objects, so that robot-env pairs go through
+    // the environment tree
+    XBot::Collision::Shape::Box box;
+    box.size << 0.2, 0.2, 0.2;
+
+    for(int i = 0; i < 3; i++)
+    {
+        Eigen::Affine3d w_T_c;
+        w_T_c.setIdentity();
+        w_T_c.translation() << 0.5, -0.5 + 0.5*i, 0.5;
+
+        cm.addCollisionShape(fmt::format("box_{}", i), "world", box, w_T_c);
+    }
+
+    Eigen::VectorXd d(cm.getNumCollisionPairs());
+    Eigen::VectorXd d_env(cm.getNumCollisionPairs(true));
+    Eigen::MatrixXd J(d.size(), model->getNv());
+
+    const double th = 0.05;
+
     {
         MemoryTracer mt;
         cm.update();
@@ -268,6 +287,43 @@ TEST_F(TestMemory, checkCollisionModelMalloc)
     }
     EXPECT_EQ(malloc_calls, 0) << "getDistanceJacobian";
     EXPECT_EQ(free_calls, 0) << "getDistanceJacobian";
+
+    // broadphase (sweep and prune, environment tree)
+    {
+        MemoryTracer mt;
+        cm.computeDistance(d_env, true, th);
+    }
+    EXPECT_EQ(malloc_calls, 0) << "computeDistance (threshold)";
+    EXPECT_EQ(free_calls, 0) << "computeDistance (threshold)";
+
+    // active jacobian: outputs are sized by a first call, as their size
+    // depends on the active set
+    std::vector<int> active_idx, active_cols;
+    Eigen::MatrixXd J_active, J_compact;
+    active_idx.reserve(d_env.size());
+    active_cols.reserve(model->getNv());
+    cm.getActiveDistanceJacobian(th, active_idx, J_active, true);
+    cm.getActiveDistanceJacobian(th, active_idx, active_cols, J_compact, true);
+
+    {
+        MemoryTracer mt;
+        cm.getActiveDistanceJacobian(th, active_idx, J_active, true);
+        cm.getActiveDistanceJacobian(th, active_idx, active_cols, J_compact, true);
+    }
+    EXPECT_EQ(malloc_calls, 0) << "getActiveDistanceJacobian";
+    EXPECT_EQ(free_calls, 0) << "getActiveDistanceJacobian";
+
+    // thread pool
+    cm.setNumThreads(4);
+
+    {
+        MemoryTracer mt;
+        cm.update();
+        cm.computeDistance(d);
+        cm.computeDistance(d_env, true, th);
+    }
+    EXPECT_EQ(malloc_calls, 0) << "computeDistance (thread pool)";
+    EXPECT_EQ(free_calls, 0) << "computeDistance (thread pool)";
 }
 
 int main(int argc, char **argv)